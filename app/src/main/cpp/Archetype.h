@@ -0,0 +1,119 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ARCHETYPE_H
+#define ANDROIDGLINVESTIGATIONS_ARCHETYPE_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*!
+ * Up to @a Capacity entities that all carry the same @a Components, stored as one packed array
+ * per component so a system that walks the entities touches only the components it needs, in
+ * order. Rows are dense: removing one moves the last entity into its place, so a row number only
+ * names an entity until the next removal. Nothing is allocated after construction.
+ */
+template<int Capacity, typename... Components>
+class Archetype {
+public:
+    static constexpr int kCapacity = Capacity;
+
+    static_assert(Capacity > 0, "an archetype holds at least one entity");
+    static_assert(sizeof...(Components) > 0, "an archetype needs at least one component");
+    static_assert((std::is_trivially_copyable_v<Components> && ...),
+                  "components are plain data that can be moved between rows");
+
+    inline int size() const { return size_; }
+
+    inline bool empty() const { return size_ == 0; }
+
+    inline bool full() const { return size_ == Capacity; }
+
+    inline void clear() { size_ = 0; }
+
+    /*!
+     * Adds an entity at the end.
+     * @return its row, or -1 if the archetype is full
+     */
+    int add(const Components &... components) {
+        if (full()) {
+            return -1;
+        }
+        const int row = size_++;
+        ((column<Components>()[row] = components), ...);
+        return row;
+    }
+
+    //! removes the entity at @a row; the last entity takes its row
+    void removeAt(int row) {
+        assert(row >= 0 && row < size_);
+        const int last = --size_;
+        if (row != last) {
+            ((column<Components>()[row] = column<Components>()[last]), ...);
+        }
+    }
+
+    //! the packed array of @a Component, @a size() entries long
+    template<typename Component>
+    inline Component *column() {
+        return std::get<std::array<Component, Capacity>>(columns_).data();
+    }
+
+    template<typename Component>
+    inline const Component *column() const {
+        return std::get<std::array<Component, Capacity>>(columns_).data();
+    }
+
+    template<typename Component>
+    inline Component &get(int row) {
+        assert(row >= 0 && row < size_);
+        return column<Component>()[row];
+    }
+
+    template<typename Component>
+    inline const Component &get(int row) const {
+        assert(row >= 0 && row < size_);
+        return column<Component>()[row];
+    }
+
+    //! calls @a visit(Components &...) for every entity, in row order
+    template<typename Visitor>
+    void forEach(Visitor &&visit) {
+        for (int row = 0; row < size_; ++row) {
+            visit(column<Components>()[row]...);
+        }
+    }
+
+    template<typename Visitor>
+    void forEach(Visitor &&visit) const {
+        for (int row = 0; row < size_; ++row) {
+            visit(column<Components>()[row]...);
+        }
+    }
+
+    /*!
+     * Removes every entity for which @a shouldRemove(const Components &...) is true. The order of
+     * the entities left is not kept.
+     * @return the number removed
+     */
+    template<typename Predicate>
+    int removeIf(Predicate &&shouldRemove) {
+        int removed = 0;
+        for (int row = 0; row < size_;) {
+            if (shouldRemove(std::as_const(column<Components>()[row])...)) {
+                removeAt(row);
+                ++removed;
+            } else {
+                ++row;
+            }
+        }
+        return removed;
+    }
+
+private:
+    std::tuple<std::array<Components, Capacity>...> columns_{};
+    int size_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ARCHETYPE_H
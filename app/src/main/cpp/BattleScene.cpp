@@ -0,0 +1,61 @@
+#include "BattleScene.h"
+
+namespace {
+
+constexpr float kPortraitWidthPx = 200.0f;
+constexpr float kPortraitHeightPx = 240.0f;
+constexpr float kScreenEdgeGapPx = 40.0f;
+constexpr float kHealthBarHeightPx = 20.0f;
+constexpr float kShieldBarHeightPx = 10.0f;
+constexpr float kShieldBarGapPx = 6.0f;
+
+} // namespace
+
+void BattleScene::stageDuel() {
+    combatants.clear();
+    widgets.clear();
+
+    const float left = -kPortraitWidthPx * 0.5f;
+    const float heroTop = -kPortraitHeightPx - kScreenEdgeGapPx;
+    combatants.add(Portrait{ActorRole::Hero},
+                   ScreenLayout{0.5f, 1.0f, left, heroTop, kPortraitWidthPx, kPortraitHeightPx},
+                   Vitals{CombatStats::kHeroMaxHP, CombatStats::kHeroMaxHP,
+                          0, CombatStats::kHeroMaxShield});
+    const float heroHealthTop = heroTop - kHealthBarHeightPx;
+    widgets.add(StatWidget{WidgetKind::HealthBar, ActorRole::Hero},
+                ScreenLayout{0.5f, 1.0f, left, heroHealthTop,
+                             kPortraitWidthPx, kHealthBarHeightPx});
+    widgets.add(StatWidget{WidgetKind::ShieldBar, ActorRole::Hero},
+                ScreenLayout{0.5f, 1.0f, left,
+                             heroHealthTop - kShieldBarHeightPx - kShieldBarGapPx,
+                             kPortraitWidthPx, kShieldBarHeightPx});
+
+    combatants.add(Portrait{ActorRole::Enemy},
+                   ScreenLayout{0.5f, 0.0f, left, kScreenEdgeGapPx,
+                                kPortraitWidthPx, kPortraitHeightPx},
+                   Vitals{CombatStats::kEnemyMaxHP, CombatStats::kEnemyMaxHP, 0, 0});
+    widgets.add(StatWidget{WidgetKind::HealthBar, ActorRole::Enemy},
+                ScreenLayout{0.5f, 0.0f, left, kScreenEdgeGapPx + kPortraitHeightPx,
+                             kPortraitWidthPx, kHealthBarHeightPx});
+}
+
+void BattleScene::syncVitals(const CombatStats &stats) {
+    combatants.forEach([&stats](const Portrait &portrait, const ScreenLayout &, Vitals &vitals) {
+        if (portrait.role == ActorRole::Hero) {
+            vitals.hp = stats.heroHP;
+            vitals.shield = stats.heroShield;
+        } else {
+            vitals.hp = stats.enemyHP;
+        }
+    });
+}
+
+const Vitals *BattleScene::vitalsOf(ActorRole role) const {
+    const Portrait *portraits = combatants.column<Portrait>();
+    for (int row = 0; row < combatants.size(); ++row) {
+        if (portraits[row].role == role) {
+            return &combatants.column<Vitals>()[row];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,102 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BATTLESCENE_H
+#define ANDROIDGLINVESTIGATIONS_BATTLESCENE_H
+
+#include <cstdint>
+
+#include "Archetype.h"
+#include "GameSession.h"
+#include "ParticleEmitters.h"
+#include "ParticlePool.h"
+
+/*!
+ * Which side of the battle an actor fights on.
+ */
+enum class ActorRole : uint8_t {
+    Hero,
+    Enemy,
+};
+
+/*!
+ * Where something sits on screen, pinned to a point given as a fraction of the screen's width and
+ * height from its top left, so it follows the screen as it resizes.
+ */
+struct ScreenLayout {
+    float anchorX;
+    float anchorY;
+    //! top left corner relative to the anchor, in pixels
+    float offsetXPx;
+    float offsetYPx;
+    float widthPx;
+    float heightPx;
+
+    inline float leftPx(float screenWidth) const { return anchorX * screenWidth + offsetXPx; }
+
+    inline float topPx(float screenHeight) const { return anchorY * screenHeight + offsetYPx; }
+};
+
+/*!
+ * An actor's portrait; the renderer picks its texture by role.
+ */
+struct Portrait {
+    ActorRole role;
+};
+
+/*!
+ * Hit points and shield of one actor as last shown.
+ */
+struct Vitals {
+    int hp;
+    int maxHP;
+    int shield;
+    int maxShield;
+};
+
+/*!
+ * The stat a bar widget shows.
+ */
+enum class WidgetKind : uint8_t {
+    HealthBar,
+    //! hidden while the shield is down
+    ShieldBar,
+};
+
+/*!
+ * A bar showing one stat of the actor playing @a owner.
+ */
+struct StatWidget {
+    WidgetKind kind;
+    ActorRole owner;
+};
+
+/*!
+ * Everything on screen besides the board, grouped by the components it carries: the combatants,
+ * the bars showing their stats and the particles of matched elements. The actors and bars are
+ * @a Archetype s and the systems below walk their packed arrays; the particles of every element
+ * share one @a ParticlePool, fed by @a ParticleEmitters. The renderer only draws what is here.
+ * Runes stay in @a RuneAnimation, which already keeps one packed array per coordinate and
+ * indexes them by cell.
+ */
+class BattleScene {
+public:
+    static constexpr int kMaxCombatants = 8;
+    static constexpr int kMaxWidgets = 3 * kMaxCombatants;
+
+    Archetype<kMaxCombatants, Portrait, ScreenLayout, Vitals> combatants;
+    Archetype<kMaxWidgets, StatWidget, ScreenLayout> widgets;
+    ParticlePool particles;
+    ParticleEmitters emitters;
+
+    /*!
+     * Puts the hero at the bottom of the screen and the enemy at the top, each with a health bar
+     * between it and the board and the hero with a shield bar as well. Particles are kept.
+     */
+    void stageDuel();
+
+    //! copies @a stats into the actors' vitals
+    void syncVitals(const CombatStats &stats);
+
+    //! @return the vitals of the first actor playing @a role, or nullptr if there is none
+    const Vitals *vitalsOf(ActorRole role) const;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_BATTLESCENE_H
@@ -0,0 +1,121 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BINARYSTREAM_H
+#define ANDROIDGLINVESTIGATIONS_BINARYSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Appends little-endian integers to a byte buffer, so files written on device read back the same
+ * on any host.
+ */
+class ByteWriter {
+public:
+    explicit ByteWriter(std::vector<uint8_t> &bytes) : bytes_(bytes) {}
+
+    inline void u8(uint8_t value) {
+        bytes_.push_back(value);
+    }
+
+    inline void u16(uint16_t value) {
+        u8(static_cast<uint8_t>(value));
+        u8(static_cast<uint8_t>(value >> 8));
+    }
+
+    inline void u32(uint32_t value) {
+        u16(static_cast<uint16_t>(value));
+        u16(static_cast<uint16_t>(value >> 16));
+    }
+
+    inline void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+
+    inline void i16(int16_t value) {
+        u16(static_cast<uint16_t>(value));
+    }
+
+    //! 7 bits per byte, low bits first; small values take a single byte
+    inline void varint(uint32_t value) {
+        while (value >= 0x80) {
+            u8(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        u8(static_cast<uint8_t>(value));
+    }
+
+    inline void bytes(const uint8_t *data, size_t size) {
+        bytes_.insert(bytes_.end(), data, data + size);
+    }
+
+private:
+    std::vector<uint8_t> &bytes_;
+};
+
+/*!
+ * Reads what @a ByteWriter wrote. Reading past the end yields zeros and clears @a ok, so a caller
+ * can parse a whole record and check once at the end.
+ */
+class ByteReader {
+public:
+    ByteReader(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    inline bool ok() const { return ok_; }
+
+    inline bool atEnd() const { return position_ == size_; }
+
+    inline uint8_t u8() {
+        if (position_ >= size_) {
+            ok_ = false;
+            return 0;
+        }
+        return data_[position_++];
+    }
+
+    inline uint16_t u16() {
+        const uint16_t low = u8();
+        return static_cast<uint16_t>(low | u8() << 8);
+    }
+
+    inline uint32_t u32() {
+        const uint32_t low = u16();
+        return low | static_cast<uint32_t>(u16()) << 16;
+    }
+
+    inline uint64_t u64() {
+        const uint64_t low = u32();
+        return low | static_cast<uint64_t>(u32()) << 32;
+    }
+
+    inline int16_t i16() {
+        return static_cast<int16_t>(u16());
+    }
+
+    inline uint32_t varint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            const uint8_t byte = u8();
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    inline void bytes(uint8_t *out, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = u8();
+        }
+    }
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t position_ = 0;
+    bool ok_ = true;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_BINARYSTREAM_H
@@ -0,0 +1,196 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BITMASK_H
+#define ANDROIDGLINVESTIGATIONS_BITMASK_H
+
+#include <array>
+#include <cstdint>
+
+/*!
+ * A fixed set of @a Bits bits packed into as few 64-bit words as possible. Masks of up to 64 bits
+ * are a single word and compile down to plain integer operations; every further 64 bits adds one
+ * word to each operation. Bits at or above @a Bits are always kept clear, so @a count and equality
+ * never see stray bits shifted in from outside the set.
+ */
+template<int Bits>
+struct BitMask {
+    static_assert(Bits > 0, "a mask needs at least one bit");
+
+    static constexpr int kWords = (Bits + 63) / 64;
+    static constexpr uint64_t kTopWordMask =
+            Bits % 64 == 0 ? ~uint64_t{0} : (uint64_t{1} << (Bits % 64)) - 1;
+
+    std::array<uint64_t, kWords> words{};
+
+    static constexpr BitMask bit(int index) {
+        BitMask mask;
+        mask.words[index >> 6] = uint64_t{1} << (index & 63);
+        return mask;
+    }
+
+    static constexpr BitMask full() {
+        BitMask mask;
+        for (auto &word: mask.words) {
+            word = ~uint64_t{0};
+        }
+        mask.words[kWords - 1] = kTopWordMask;
+        return mask;
+    }
+
+    constexpr bool test(int index) const {
+        return ((words[index >> 6] >> (index & 63)) & 1U) != 0;
+    }
+
+    constexpr void set(int index) {
+        words[index >> 6] |= uint64_t{1} << (index & 63);
+    }
+
+    constexpr void reset(int index) {
+        words[index >> 6] &= ~(uint64_t{1} << (index & 63));
+    }
+
+    constexpr bool any() const {
+        uint64_t accumulated = 0;
+        for (const auto word: words) {
+            accumulated |= word;
+        }
+        return accumulated != 0;
+    }
+
+    constexpr bool none() const {
+        return !any();
+    }
+
+    constexpr explicit operator bool() const {
+        return any();
+    }
+
+    constexpr int count() const {
+        int total = 0;
+        for (const auto word: words) {
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+
+    /*!
+     * @return the index of the lowest set bit. The mask must not be empty.
+     */
+    constexpr int lowest() const {
+        for (int i = 0; i < kWords; ++i) {
+            if (words[i]) {
+                return i * 64 + __builtin_ctzll(words[i]);
+            }
+        }
+        return Bits;
+    }
+
+    /*!
+     * Calls @a visit(index) for every set bit, lowest first.
+     */
+    template<typename Visitor>
+    void forEach(Visitor &&visit) const {
+        for (int i = 0; i < kWords; ++i) {
+            for (uint64_t word = words[i]; word; word &= word - 1) {
+                visit(i * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+
+    constexpr BitMask operator&(const BitMask &other) const {
+        BitMask result;
+        for (int i = 0; i < kWords; ++i) {
+            result.words[i] = words[i] & other.words[i];
+        }
+        return result;
+    }
+
+    constexpr BitMask operator|(const BitMask &other) const {
+        BitMask result;
+        for (int i = 0; i < kWords; ++i) {
+            result.words[i] = words[i] | other.words[i];
+        }
+        return result;
+    }
+
+    constexpr BitMask operator^(const BitMask &other) const {
+        BitMask result;
+        for (int i = 0; i < kWords; ++i) {
+            result.words[i] = words[i] ^ other.words[i];
+        }
+        return result;
+    }
+
+    constexpr BitMask operator~() const {
+        BitMask result;
+        for (int i = 0; i < kWords; ++i) {
+            result.words[i] = ~words[i];
+        }
+        result.words[kWords - 1] &= kTopWordMask;
+        return result;
+    }
+
+    /*!
+     * Moves every bit towards higher indices. @a shift must be in [0, 64).
+     */
+    constexpr BitMask operator<<(int shift) const {
+        BitMask result;
+        if constexpr (kWords == 1) {
+            result.words[0] = (words[0] << shift) & kTopWordMask;
+        } else {
+            if (shift == 0) {
+                return *this;
+            }
+            for (int i = kWords - 1; i > 0; --i) {
+                result.words[i] = (words[i] << shift) | (words[i - 1] >> (64 - shift));
+            }
+            result.words[0] = words[0] << shift;
+            result.words[kWords - 1] &= kTopWordMask;
+        }
+        return result;
+    }
+
+    /*!
+     * Moves every bit towards lower indices. @a shift must be in [0, 64).
+     */
+    constexpr BitMask operator>>(int shift) const {
+        BitMask result;
+        if constexpr (kWords == 1) {
+            result.words[0] = words[0] >> shift;
+        } else {
+            if (shift == 0) {
+                return *this;
+            }
+            for (int i = 0; i < kWords - 1; ++i) {
+                result.words[i] = (words[i] >> shift) | (words[i + 1] << (64 - shift));
+            }
+            result.words[kWords - 1] = words[kWords - 1] >> shift;
+        }
+        return result;
+    }
+
+    constexpr BitMask &operator&=(const BitMask &other) {
+        return *this = *this & other;
+    }
+
+    constexpr BitMask &operator|=(const BitMask &other) {
+        return *this = *this | other;
+    }
+
+    constexpr BitMask &operator^=(const BitMask &other) {
+        return *this = *this ^ other;
+    }
+
+    constexpr bool operator==(const BitMask &other) const {
+        for (int i = 0; i < kWords; ++i) {
+            if (words[i] != other.words[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator!=(const BitMask &other) const {
+        return !(*this == other);
+    }
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_BITMASK_H
@@ -0,0 +1,118 @@
+#include "BoardDelta.h"
+
+void BoardDeltaLog::append(BoardDeltaKind kind, int cell, int value) {
+    BoardDelta &delta = entries_[next_ & (kCapacity - 1)];
+    delta.sequence = next_;
+    delta.kind = kind;
+    delta.cell = static_cast<uint8_t>(cell);
+    delta.value = static_cast<int16_t>(value);
+    ++next_;
+}
+
+void BoardDeltaLog::appendReset(const GameBoard &board, const CombatStats &stats, GameState state) {
+    append(BoardDeltaKind::Reset, 0, 0);
+    for (int index = 0; index < GameBoard::kCells; ++index) {
+        append(BoardDeltaKind::Spawn, index, static_cast<int>(board.at(index)));
+    }
+    board.specialCells().forEach([this, &board](int index) {
+        append(BoardDeltaKind::Special, index, static_cast<int>(board.special(index)));
+    });
+    append(BoardDeltaKind::HeroHP, 0, stats.heroHP);
+    append(BoardDeltaKind::EnemyHP, 0, stats.enemyHP);
+    append(BoardDeltaKind::HeroShield, 0, stats.heroShield);
+    append(BoardDeltaKind::State, 0, static_cast<int>(state));
+    stats_ = stats;
+    state_ = state;
+}
+
+void BoardDeltaLog::appendSwap(int firstIndex, int secondIndex) {
+    append(BoardDeltaKind::Swap, firstIndex, secondIndex);
+}
+
+void BoardDeltaLog::appendCleared(const GameBoard::Mask &cells) {
+    cells.forEach([this](int index) {
+        append(BoardDeltaKind::Clear, index, 0);
+    });
+}
+
+void BoardDeltaLog::appendSpecial(int index, SpecialRune special) {
+    append(BoardDeltaKind::Special, index, static_cast<int>(special));
+}
+
+void BoardDeltaLog::appendGravity(const GameBoard::Gravity &gravity, const GameBoard &board) {
+    // bottom up, so every gem has moved on before another one lands on its cell
+    for (int index = GameBoard::kCells - 1; index >= 0; --index) {
+        if (gravity.moved.test(index)) {
+            append(BoardDeltaKind::Move, index,
+                   index - gravity.fallRows[index] * GameBoard::kColumns);
+        }
+    }
+    gravity.refilled.forEach([this, &board](int index) {
+        append(BoardDeltaKind::Spawn, index, static_cast<int>(board.at(index)));
+    });
+}
+
+void BoardDeltaLog::appendStats(const CombatStats &stats, GameState state) {
+    if (stats.heroHP != stats_.heroHP) {
+        append(BoardDeltaKind::HeroHP, 0, stats.heroHP);
+    }
+    if (stats.enemyHP != stats_.enemyHP) {
+        append(BoardDeltaKind::EnemyHP, 0, stats.enemyHP);
+    }
+    if (stats.heroShield != stats_.heroShield) {
+        append(BoardDeltaKind::HeroShield, 0, stats.heroShield);
+    }
+    if (state != state_) {
+        append(BoardDeltaKind::State, 0, static_cast<int>(state));
+    }
+    stats_ = stats;
+    state_ = state;
+}
+
+bool BoardDeltaMirror::apply(const BoardDelta &delta) {
+    if (delta.sequence != nextSequence) {
+        synced = false;
+    }
+    nextSequence = delta.sequence + 1;
+    if (delta.kind == BoardDeltaKind::Reset) {
+        board = GameBoard{};
+        synced = true;
+        return true;
+    }
+    if (!synced) {
+        return false;
+    }
+
+    switch (delta.kind) {
+        case BoardDeltaKind::Reset:
+            break;
+        case BoardDeltaKind::Swap:
+            board.swapCells(delta.cell, delta.value);
+            break;
+        case BoardDeltaKind::Clear:
+            board.set(delta.cell, GemType::None);
+            break;
+        case BoardDeltaKind::Move:
+            board.moveGem(delta.value, delta.cell);
+            break;
+        case BoardDeltaKind::Spawn:
+            board.set(delta.cell, static_cast<GemType>(delta.value));
+            break;
+        case BoardDeltaKind::Special:
+            board.setSpecial(delta.cell, static_cast<SpecialRune>(delta.value));
+            break;
+        case BoardDeltaKind::HeroHP:
+            stats.heroHP = delta.value;
+            break;
+        case BoardDeltaKind::EnemyHP:
+            stats.enemyHP = delta.value;
+            break;
+        case BoardDeltaKind::HeroShield:
+            stats.heroShield = delta.value;
+            break;
+        case BoardDeltaKind::State:
+            state = static_cast<GameState>(delta.value);
+            break;
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BOARDDELTA_H
+#define ANDROIDGLINVESTIGATIONS_BOARDDELTA_H
+
+#include <array>
+#include <cstdint>
+
+#include "GameSession.h"
+
+/*!
+ * What a single @a BoardDelta changed.
+ */
+enum class BoardDeltaKind : uint8_t {
+    /*!
+     * The board starts over. A spawn for every cell, the special runes and the full stats and
+     * state follow, so a consumer that missed deltas can pick the stream up again here.
+     */
+    Reset,
+    //! the gems in @a cell and in cell @a value traded places
+    Swap,
+    //! @a cell was emptied
+    Clear,
+    //! the gem in cell @a value fell into @a cell, leaving cell @a value empty
+    Move,
+    //! a new gem of type @a value appeared in @a cell
+    Spawn,
+    //! the gem in @a cell became the @a SpecialRune @a value; it moves along with its gem
+    Special,
+    //! @a value is the hero's new hit points
+    HeroHP,
+    //! @a value is the enemy's new hit points
+    EnemyHP,
+    //! @a value is the hero's new shield
+    HeroShield,
+    //! @a value is the new @a GameState
+    State,
+};
+
+/*!
+ * One change to a session's board or stats. Sequence numbers count up by one per delta, so a gap
+ * tells a consumer it missed something.
+ */
+struct BoardDelta {
+    uint32_t sequence = 0;
+    BoardDeltaKind kind = BoardDeltaKind::Reset;
+    uint8_t cell = 0;
+    int16_t value = 0;
+};
+
+static_assert(sizeof(BoardDelta) == 8, "deltas are meant to stay at two words");
+
+/*!
+ * The most recent deltas a @a GameSession emitted, in a fixed ring. Attach one with
+ * @a GameSession::setDeltaLog; consumers remember the sequence they read up to and take what was
+ * appended since, so they update only what changed instead of diffing whole boards.
+ */
+class BoardDeltaLog {
+public:
+    //! deltas kept; a cascade of a dozen steps on a full board fits
+    static constexpr uint32_t kCapacity = 1024;
+    //! the most deltas a Reset and what follows it take, with a rune on every cell
+    static constexpr int kResetDeltas = 1 + 2 * GameBoard::kCells + 4;
+
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "the ring wraps with a mask");
+
+    //! the sequence number the next delta will get
+    inline uint32_t nextSequence() const { return next_; }
+
+    void append(BoardDeltaKind kind, int cell, int value);
+
+    //! a Reset for @a board with the full @a stats and @a state
+    void appendReset(const GameBoard &board, const CombatStats &stats, GameState state);
+
+    void appendSwap(int firstIndex, int secondIndex);
+
+    void appendCleared(const GameBoard::Mask &cells);
+
+    void appendSpecial(int index, SpecialRune special);
+
+    //! the moves, bottom-most first, then the spawns @a gravity made on @a board
+    void appendGravity(const GameBoard::Gravity &gravity, const GameBoard &board);
+
+    //! only the values that differ from the last ones appended
+    void appendStats(const CombatStats &stats, GameState state);
+
+    /*!
+     * Calls @a visit(const BoardDelta &) for every delta from @a sequence on.
+     * @return false, visiting nothing, if some of them were already overwritten
+     */
+    template<typename Visitor>
+    bool forEachSince(uint32_t sequence, Visitor &&visit) const {
+        const uint32_t pending = next_ - sequence;
+        if (pending > kCapacity || pending > next_) {
+            return false;
+        }
+        for (uint32_t current = sequence; current != next_; ++current) {
+            visit(entries_[current & (kCapacity - 1)]);
+        }
+        return true;
+    }
+
+private:
+    std::array<BoardDelta, kCapacity> entries_{};
+    uint32_t next_ = 0;
+    //! what the stream last said about the stats, so unchanged values are left out
+    CombatStats stats_;
+    GameState state_ = GameState::START;
+};
+
+/*!
+ * A board and stats kept up to date from deltas alone, as a UI bridge or replay viewer would.
+ */
+struct BoardDeltaMirror {
+    GameBoard board;
+    CombatStats stats;
+    GameState state = GameState::START;
+    //! the sequence expected next
+    uint32_t nextSequence = 0;
+    //! false until the first Reset, and again after a gap until the next one
+    bool synced = false;
+
+    /*!
+     * Applies @a delta. After a gap in the sequence everything up to the next Reset is skipped.
+     * @return false if @a delta was skipped
+     */
+    bool apply(const BoardDelta &delta);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_BOARDDELTA_H
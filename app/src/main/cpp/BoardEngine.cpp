@@ -0,0 +1,7 @@
+#include "BoardEngine.h"
+
+// The shipped board shapes are instantiated once here instead of in every translation unit that
+// includes the header.
+template class BoardEngine<8, 5, 4>;
+template class BoardEngine<9, 9, 4>;
+template class BoardEngine<16, 16, 4>;
@@ -0,0 +1,1327 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BOARDENGINE_H
+#define ANDROIDGLINVESTIGATIONS_BOARDENGINE_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+#include "BitMask.h"
+
+enum class GemType {
+    None = -1,
+    Fire = 0,
+    Water = 1,
+    Air = 2,
+    Earth = 3,
+};
+
+/*!
+ * What a gem does when it is cleared, besides clearing. Special runes form where a match has a
+ * shape beyond a plain run of three and keep their gem type, so they match like any other gem.
+ */
+enum class SpecialRune : uint8_t {
+    None = 0,
+    //! formed by four in a row; clears its whole row
+    RowBlast,
+    //! formed by four in a column; clears its whole column
+    ColumnBlast,
+    //! formed where a row run crosses a column run; clears the 3x3 block around it
+    Bomb,
+    //! formed by five or more in a line; clears every gem of its type
+    Prism,
+};
+
+static constexpr int kSpecialRuneKinds = 5;
+
+/*!
+ * The shapes of matched groups that earn a special rune. Plain runs of three earn nothing.
+ */
+enum class MatchShape : uint8_t {
+    //! exactly four in a line
+    Line4,
+    //! five or more in a line
+    Line5,
+    //! a row run and a column run meeting at an end of each
+    L,
+    //! one run ending in the middle of the other
+    T,
+    //! two runs crossing in the middle of both
+    Cross,
+};
+
+namespace bitboard {
+
+/*!
+ * Calls @a body(std::integral_constant<int, I>{}) for every I in [0, N). Loops over compile-time
+ * counts (gem types, mask words) go through this so every instantiation gets them fully unrolled.
+ */
+template<typename Body, int... I>
+constexpr void staticForImpl(Body &&body, std::integer_sequence<int, I...>) {
+    (body(std::integral_constant<int, I>{}), ...);
+}
+
+template<int N, typename Body>
+constexpr void staticFor(Body &&body) {
+    staticForImpl(body, std::make_integer_sequence<int, N>{});
+}
+
+/*!
+ * The horizontal and vertical three-cell windows that contain a given cell. A cell is covered by
+ * at most three windows along each axis.
+ */
+template<int Cells>
+struct CellWindows {
+    std::array<BitMask<Cells>, 6> windows{};
+    int count = 0;
+};
+
+/*!
+ * Lookup tables for one board shape, all built at compile time. Bit (row * Cols + col) is the cell
+ * at row, col, so a row is a contiguous run of Cols bits and one row down is a shift by Cols.
+ */
+template<int Rows, int Cols>
+struct BoardTables {
+    typedef BitMask<Rows * Cols> Mask;
+
+    std::array<Mask, Rows> rows{};
+    std::array<Mask, Cols> columns{};
+    Mask full{};
+    //! cells whose two right-hand neighbours are on the same row; keeps shifts from wrapping
+    Mask horizontalRunStarts{};
+    //! the same for the three right-hand neighbours a run of four needs
+    Mask horizontalRun4Starts{};
+    std::array<CellWindows<Rows * Cols>, Rows * Cols> windows{};
+    //! per cell, its left and right neighbours
+    std::array<Mask, Rows * Cols> rowNeighbours{};
+    //! per cell, its upper and lower neighbours
+    std::array<Mask, Rows * Cols> columnNeighbours{};
+    //! per cell, the block of up to 3x3 cells centred on it
+    std::array<Mask, Rows * Cols> blastAreas{};
+};
+
+template<int Rows, int Cols>
+constexpr BoardTables<Rows, Cols> buildBoardTables() {
+    typedef BitMask<Rows * Cols> Mask;
+    BoardTables<Rows, Cols> tables{};
+    tables.full = Mask::full();
+    for (int row = 0; row < Rows; ++row) {
+        for (int col = 0; col < Cols; ++col) {
+            const Mask cell = Mask::bit(row * Cols + col);
+            tables.rows[row] |= cell;
+            tables.columns[col] |= cell;
+            if (col + 2 < Cols) {
+                tables.horizontalRunStarts |= cell;
+            }
+            if (col + 3 < Cols) {
+                tables.horizontalRun4Starts |= cell;
+            }
+
+            for (int dRow = -1; dRow <= 1; ++dRow) {
+                for (int dCol = -1; dCol <= 1; ++dCol) {
+                    const int r = row + dRow;
+                    const int c = col + dCol;
+                    if (r < 0 || r >= Rows || c < 0 || c >= Cols) {
+                        continue;
+                    }
+                    const Mask neighbour = Mask::bit(r * Cols + c);
+                    tables.blastAreas[row * Cols + col] |= neighbour;
+                    if (dRow == 0 && dCol != 0) {
+                        tables.rowNeighbours[row * Cols + col] |= neighbour;
+                    } else if (dCol == 0 && dRow != 0) {
+                        tables.columnNeighbours[row * Cols + col] |= neighbour;
+                    }
+                }
+            }
+
+            auto &entry = tables.windows[row * Cols + col];
+            for (int start = col - 2; start <= col; ++start) {
+                if (start < 0 || start + 2 >= Cols) {
+                    continue;
+                }
+                entry.windows[entry.count++] = Mask::bit(row * Cols + start) |
+                                               Mask::bit(row * Cols + start + 1) |
+                                               Mask::bit(row * Cols + start + 2);
+            }
+            for (int start = row - 2; start <= row; ++start) {
+                if (start < 0 || start + 2 >= Rows) {
+                    continue;
+                }
+                entry.windows[entry.count++] = Mask::bit(start * Cols + col) |
+                                               Mask::bit((start + 1) * Cols + col) |
+                                               Mask::bit((start + 2) * Cols + col);
+            }
+        }
+    }
+    return tables;
+}
+
+template<int Rows, int Cols>
+inline constexpr BoardTables<Rows, Cols> kBoardTables = buildBoardTables<Rows, Cols>();
+
+/*!
+ * Where gravity takes the gems of one column, given which of its cells hold a gem. Gems keep
+ * their order, so the gem that ends up in row r came from row r - fall[r]; the top @a refills
+ * rows are filled with new gems, which drop in from as many rows above the board.
+ */
+template<int Rows>
+struct ColumnFall {
+    std::array<uint8_t, Rows> fall{};
+    uint8_t refills = 0;
+    //! bit r is set for every row whose gem changes: the lowest gap and everything above it
+    uint32_t changedRows = 0;
+};
+
+/*!
+ * Compacts a column whose occupied rows are the set bits of @a occupancy, row 0 at the top.
+ */
+template<int Rows>
+constexpr ColumnFall<Rows> compactColumn(uint32_t occupancy) {
+    ColumnFall<Rows> column{};
+    int writeRow = Rows - 1;
+    for (int row = Rows - 1; row >= 0; --row) {
+        if ((occupancy >> row) & 1U) {
+            column.fall[writeRow] = static_cast<uint8_t>(writeRow - row);
+            --writeRow;
+        }
+    }
+    column.refills = static_cast<uint8_t>(writeRow + 1);
+    for (int row = 0; row <= writeRow; ++row) {
+        column.fall[row] = column.refills;
+    }
+    for (int row = Rows - 1; row >= 0; --row) {
+        if (!((occupancy >> row) & 1U)) {
+            column.changedRows = row == 31 ? ~0U : (2U << row) - 1;
+            break;
+        }
+    }
+    return column;
+}
+
+template<int Rows>
+constexpr std::array<ColumnFall<Rows>, (1U << Rows)> buildColumnFalls() {
+    std::array<ColumnFall<Rows>, (1U << Rows)> table{};
+    for (uint32_t occupancy = 0; occupancy < (1U << Rows); ++occupancy) {
+        table[occupancy] = compactColumn<Rows>(occupancy);
+    }
+    return table;
+}
+
+/*!
+ * Every column of up to eight rows compacted in advance, indexed by its occupancy.
+ */
+template<int Rows>
+inline constexpr std::array<ColumnFall<Rows>, (1U << Rows)> kColumnFalls =
+        buildColumnFalls<Rows>();
+
+/*!
+ * @return how gravity compacts a column: looked up for columns of up to eight rows, which is
+ * every board the game plays on, and worked out on the spot for taller ones
+ */
+template<int Rows>
+inline ColumnFall<Rows> columnFall(uint32_t occupancy) {
+    if constexpr (Rows <= 8) {
+        return kColumnFalls<Rows>[occupancy];
+    } else {
+        return compactColumn<Rows>(occupancy);
+    }
+}
+
+} // namespace bitboard
+
+/*!
+ * The logical match-3 board: gem storage, match detection, gravity, move generation and board
+ * generation, with no rendering or platform dependencies.
+ *
+ * Everything is specialised on the board shape and gem count. Each gem type is a BitMask with one
+ * bit per cell (a single 64-bit word for boards of up to 64 cells), next to one byte per cell for
+ * O(1) type lookups. Runs are found with shifts and ANDs, loops over gem types are unrolled and
+ * every geometric mask comes from a constexpr table, so there is no run-time row * columns
+ * arithmetic on the hot path.
+ */
+template<int Rows, int Cols, int GemTypes>
+class BoardEngine {
+public:
+    static constexpr int kRows = Rows;
+    static constexpr int kColumns = Cols;
+    static constexpr int kCells = Rows * Cols;
+    static constexpr int kGemTypes = GemTypes;
+
+    static_assert(Rows >= 3 && Cols >= 3, "a run of three has to fit in both directions");
+    static_assert(2 * Cols < 64, "vertical runs are found with shifts of up to two rows");
+    static_assert(Rows <= 32 && Cols <= 32, "dirty lines are tracked in 32-bit masks");
+    static_assert(kCells <= 256, "cells are addressed with 8-bit indices");
+    static_assert(GemTypes >= 3 && GemTypes < 255,
+                  "the single-pass generator needs a third type to fall back on");
+
+    typedef BitMask<kCells> Mask;
+
+    static constexpr uint8_t kEmptyCell = 0xFF;
+
+    static constexpr int cellIndex(int row, int col) {
+        return row * Cols + col;
+    }
+
+    static constexpr int rowOf(int index) {
+        return index / Cols;
+    }
+
+    static constexpr int columnOf(int index) {
+        return index % Cols;
+    }
+
+    /*!
+     * Tracks which rows and columns changed since the last match scan. Every new run has to
+     * contain a changed cell, so a horizontal run can only appear in a dirty row and a vertical
+     * run only in a dirty column; everything else is known to be match-free.
+     */
+    struct DirtyLines {
+        uint32_t rows = 0;
+        uint32_t columns = 0;
+
+        inline void markCell(int row, int col) {
+            rows |= 1U << row;
+            columns |= 1U << col;
+        }
+
+        inline void clear() {
+            rows = 0;
+            columns = 0;
+        }
+
+        inline bool empty() const {
+            return rows == 0 && columns == 0;
+        }
+    };
+
+    /*!
+     * A single maximal straight run, as reported by @a forEachRun.
+     */
+    struct MatchRun {
+        GemType type = GemType::None;
+        uint8_t row = 0;
+        uint8_t col = 0;
+        uint8_t length = 0;
+        bool horizontal = false;
+    };
+
+    /*!
+     * Upper bound on the runs a single scan can report: a line of length n holds at most n / 3.
+     */
+    static constexpr int kMaxMatchRuns = Rows * (Cols / 3) + Cols * (Rows / 3);
+
+    /*!
+     * The outcome of one match scan with all storage inline, so the owner can keep one around and
+     * refill it every cascade step without touching the heap.
+     */
+    struct MatchResult {
+        Mask cleared{};
+        std::array<Mask, GemTypes> clearedByType{};
+        std::array<MatchRun, kMaxMatchRuns> runs{};
+        int runCount = 0;
+
+        /*!
+         * Records @a matches found on @a board. Runs are left empty until @a collectRuns.
+         */
+        inline void assign(const BoardEngine &board, const Mask &matches) {
+            cleared = matches;
+            bitboard::staticFor<GemTypes>([&](auto type) {
+                clearedByType[type] = matches & board.gems_[type];
+            });
+            runCount = 0;
+        }
+
+        inline int count(GemType type) const {
+            return clearedByType[static_cast<int>(type)].count();
+        }
+
+        /*!
+         * Fills @a runs from @a board, which must still hold the matched gems.
+         */
+        inline void collectRuns(const BoardEngine &board) {
+            runCount = 0;
+            board.forEachRun(cleared, [this](GemType type, int row, int col, int length,
+                                             bool horizontal) {
+                if (runCount >= kMaxMatchRuns) {
+                    return;
+                }
+                MatchRun &run = runs[runCount++];
+                run.type = type;
+                run.row = static_cast<uint8_t>(row);
+                run.col = static_cast<uint8_t>(col);
+                run.length = static_cast<uint8_t>(length);
+                run.horizontal = horizontal;
+            });
+        }
+    };
+
+    /*!
+     * A swap between two orthogonally adjacent cells, stored as cell indices.
+     */
+    struct Move {
+        uint8_t from = 0;
+        uint8_t to = 0;
+    };
+
+    /*!
+     * Every adjacent pair on the board: (Cols - 1) horizontal swaps per row plus (Rows - 1)
+     * vertical swaps per column.
+     */
+    static constexpr int kMaxMoves = Rows * (Cols - 1) + (Rows - 1) * Cols;
+
+    struct MoveList {
+        std::array<Move, kMaxMoves> moves{};
+        int count = 0;
+    };
+
+    /*!
+     * A matched group that earns a special rune, as found by @a findShapes.
+     */
+    struct ShapeMatch {
+        MatchShape shape = MatchShape::Line4;
+        GemType type = GemType::None;
+        //! where the special rune forms; the gem there stays on the board
+        uint8_t cell = 0;
+        //! lines only: the group lies along a row
+        bool horizontal = false;
+
+        //! the special rune this shape earns
+        inline SpecialRune special() const {
+            switch (shape) {
+                case MatchShape::Line4:
+                    return horizontal ? SpecialRune::RowBlast : SpecialRune::ColumnBlast;
+                case MatchShape::Line5:
+                    return SpecialRune::Prism;
+                default:
+                    return SpecialRune::Bomb;
+            }
+        }
+    };
+
+    //! every group takes at least four cells and no cell is in two groups
+    static constexpr int kMaxShapes = kCells / 4;
+
+    struct ShapeList {
+        std::array<ShapeMatch, kMaxShapes> shapes{};
+        int count = 0;
+    };
+
+    BoardEngine() {
+        cells_.fill(kEmptyCell);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Storage
+
+    inline void clear() {
+        gems_.fill(Mask{});
+        cells_.fill(kEmptyCell);
+        specials_.fill(0);
+        specialCells_ = Mask{};
+        dirty_.clear();
+    }
+
+    /*!
+     * Replaces the whole board with @a gems, one mask per type; cells in none of them are left
+     * empty. The masks must not overlap. Special runes are dropped and every line is marked dirty.
+     */
+    inline void assign(const std::array<Mask, GemTypes> &gems) {
+        clear();
+        for (int type = 0; type < GemTypes; ++type) {
+            gems[type].forEach([this, type](int index) {
+                cells_[index] = static_cast<uint8_t>(type);
+            });
+        }
+        gems_ = gems;
+        markAllDirty();
+    }
+
+    /*!
+     * Puts a plain @a type (or nothing, for GemType::None) into the cell at @a index and marks its
+     * row and column dirty.
+     */
+    inline void set(int index, GemType type) {
+        setCell(index, type == GemType::None ? kEmptyCell : static_cast<uint8_t>(type));
+        setSpecialCell(index, 0);
+        dirty_.markCell(rowOf(index), columnOf(index));
+    }
+
+    /*!
+     * Moves the gem at @a from, special rune included, into @a to and empties @a from. Both are
+     * marked dirty.
+     */
+    inline void moveGem(int from, int to) {
+        setCell(to, cells_[from]);
+        setSpecialCell(to, specials_[from]);
+        set(from, GemType::None);
+        dirty_.markCell(rowOf(to), columnOf(to));
+    }
+
+    inline SpecialRune special(int index) const {
+        return static_cast<SpecialRune>(specials_[index]);
+    }
+
+    //! the cells holding a special rune
+    inline const Mask &specialCells() const {
+        return specialCells_;
+    }
+
+    /*!
+     * Turns the gem at @a index into @a special, or back into a plain gem. The cell must hold a
+     * gem. Its type is unchanged, so no line is marked dirty.
+     */
+    inline void setSpecial(int index, SpecialRune special) {
+        setSpecialCell(index, static_cast<uint8_t>(special));
+    }
+
+    inline GemType at(int index) const {
+        const uint8_t type = cells_[index];
+        return type == kEmptyCell ? GemType::None : static_cast<GemType>(type);
+    }
+
+    inline const Mask &gems(GemType type) const {
+        return gems_[static_cast<int>(type)];
+    }
+
+    inline Mask occupied() const {
+        Mask mask{};
+        bitboard::staticFor<GemTypes>([&](auto type) {
+            mask |= gems_[type];
+        });
+        return mask;
+    }
+
+    /*!
+     * Exchanges the contents of two cells and marks both dirty.
+     */
+    inline void swapCells(int first, int second) {
+        const uint8_t firstType = cells_[first];
+        setCell(first, cells_[second]);
+        setCell(second, firstType);
+        if (specialCells_.any()) {
+            const uint8_t firstSpecial = specials_[first];
+            setSpecialCell(first, specials_[second]);
+            setSpecialCell(second, firstSpecial);
+        }
+        dirty_.markCell(rowOf(first), columnOf(first));
+        dirty_.markCell(rowOf(second), columnOf(second));
+    }
+
+    //! boards with the same gem and rune in every cell compare equal, whatever their dirty lines
+    inline bool operator==(const BoardEngine &other) const {
+        return cells_ == other.cells_ && specials_ == other.specials_;
+    }
+
+    inline bool operator!=(const BoardEngine &other) const {
+        return !(*this == other);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Serialization
+
+    //! bytes needed to store every cell in two bits
+    static constexpr int kPackedBytes = (kCells + 3) / 4;
+
+    typedef std::array<uint8_t, kPackedBytes> PackedCells;
+
+    /*!
+     * Packs a full board at two bits per gem, cell 0 in the low bits of the first byte.
+     * @return false if a cell is empty, which two bits cannot express
+     */
+    bool pack(PackedCells &outPacked) const {
+        static_assert(GemTypes <= 4, "two bits per cell only hold four gem types");
+        outPacked.fill(0);
+        for (int index = 0; index < kCells; ++index) {
+            const uint8_t type = cells_[index];
+            if (type == kEmptyCell) {
+                return false;
+            }
+            outPacked[index >> 2] |= static_cast<uint8_t>(type << ((index & 3) * 2));
+        }
+        return true;
+    }
+
+    /*!
+     * Restores a board written by @a pack. Every line is marked dirty.
+     * @return false if a cell holds a type the board does not have
+     */
+    bool unpack(const PackedCells &packed) {
+        static_assert(GemTypes <= 4, "two bits per cell only hold four gem types");
+        clear();
+        for (int index = 0; index < kCells; ++index) {
+            const uint8_t type = (packed[index >> 2] >> ((index & 3) * 2)) & 3U;
+            if (type >= GemTypes) {
+                clear();
+                return false;
+            }
+            setCell(index, type);
+        }
+        markAllDirty();
+        return true;
+    }
+
+    //! bytes needed to store every cell's special rune in three bits
+    static constexpr int kPackedSpecialBytes = (kCells * 3 + 7) / 8;
+
+    typedef std::array<uint8_t, kPackedSpecialBytes> PackedSpecials;
+
+    /*!
+     * Packs the special runes at three bits per cell, cell 0 in the low bits of the first byte.
+     */
+    void packSpecials(PackedSpecials &outPacked) const {
+        static_assert(kSpecialRuneKinds <= 8, "three bits per cell only hold eight runes");
+        outPacked.fill(0);
+        specialCells_.forEach([&](int index) {
+            const uint32_t bits = static_cast<uint32_t>(specials_[index]) << ((index * 3) & 7);
+            outPacked[(index * 3) >> 3] |= static_cast<uint8_t>(bits);
+            if (bits > 0xFF) {
+                outPacked[((index * 3) >> 3) + 1] |= static_cast<uint8_t>(bits >> 8);
+            }
+        });
+    }
+
+    /*!
+     * Restores the special runes written by @a packSpecials onto a board that already holds its
+     * gems.
+     * @return false, leaving every cell plain, if a rune is unknown or sits on an empty cell
+     */
+    bool unpackSpecials(const PackedSpecials &packed) {
+        specials_.fill(0);
+        specialCells_ = Mask{};
+        for (int index = 0; index < kCells; ++index) {
+            const int byte = (index * 3) >> 3;
+            uint32_t bits = packed[byte];
+            if (byte + 1 < kPackedSpecialBytes) {
+                bits |= static_cast<uint32_t>(packed[byte + 1]) << 8;
+            }
+            const uint8_t special = (bits >> ((index * 3) & 7)) & 7U;
+            if (special == 0) {
+                continue;
+            }
+            if (special >= kSpecialRuneKinds || cells_[index] == kEmptyCell) {
+                specials_.fill(0);
+                specialCells_ = Mask{};
+                return false;
+            }
+            setSpecialCell(index, special);
+        }
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Match detection
+
+    inline const DirtyLines &dirtyLines() const {
+        return dirty_;
+    }
+
+    /*!
+     * Forgets the recorded changes. Only call this once the board is known to be match-free or
+     * the pending matches have been consumed.
+     */
+    inline void clearDirtyLines() {
+        dirty_.clear();
+    }
+
+    /*!
+     * @return every cell that is part of a horizontal or vertical run of three or more
+     */
+    inline Mask findMatches() const {
+        Mask cleared{};
+        bitboard::staticFor<GemTypes>([&](auto type) {
+            cleared |= horizontalRuns(gems_[type]) | verticalRuns(gems_[type]);
+        });
+        return cleared;
+    }
+
+    /*!
+     * Like @a findMatches, but horizontal runs are only looked for on dirty rows and vertical runs
+     * only on dirty columns. Gives the same answer as a full scan whenever the board was
+     * match-free before those lines changed.
+     */
+    inline Mask findDirtyMatches() const {
+        if (dirty_.empty()) {
+            return Mask{};
+        }
+
+        const auto &tables = bitboard::kBoardTables<Rows, Cols>;
+        Mask rowScope{};
+        for (uint32_t pending = dirty_.rows; pending; pending &= pending - 1) {
+            rowScope |= tables.rows[__builtin_ctz(pending)];
+        }
+        Mask columnScope{};
+        for (uint32_t pending = dirty_.columns; pending; pending &= pending - 1) {
+            columnScope |= tables.columns[__builtin_ctz(pending)];
+        }
+
+        Mask cleared{};
+        bitboard::staticFor<GemTypes>([&](auto type) {
+            cleared |= horizontalRuns(gems_[type] & rowScope) |
+                       verticalRuns(gems_[type] & columnScope);
+        });
+        return cleared;
+    }
+
+    /*!
+     * Splits a cleared-cell mask back into individual straight runs. Only needed by code that
+     * cares about run geometry; counting and clearing work on the masks directly.
+     *
+     * @param cleared the result of @a findMatches
+     * @param visit called as visit(type, row, col, length, horizontal) for each maximal run
+     */
+    template<typename Visitor>
+    void forEachRun(const Mask &cleared, Visitor &&visit) const {
+        const auto &tables = bitboard::kBoardTables<Rows, Cols>;
+        for (int type = 0; type < GemTypes; ++type) {
+            const Mask horizontal = horizontalRuns(gems_[type]) & cleared;
+            const Mask vertical = verticalRuns(gems_[type]) & cleared;
+            const GemType gemType = static_cast<GemType>(type);
+
+            // a run starts on every set cell whose left (or upper) neighbour is not part of it
+            const Mask horizontalHeads = horizontal & ~((horizontal << 1) & ~tables.columns[0]);
+            horizontalHeads.forEach([&](int index) {
+                int length = 1;
+                while (columnOf(index) + length < Cols && horizontal.test(index + length)) {
+                    ++length;
+                }
+                visit(gemType, rowOf(index), columnOf(index), length, true);
+            });
+
+            const Mask verticalHeads = vertical & ~(vertical << Cols);
+            verticalHeads.forEach([&](int index) {
+                int length = 1;
+                while (rowOf(index) + length < Rows && vertical.test(index + length * Cols)) {
+                    ++length;
+                }
+                visit(gemType, rowOf(index), columnOf(index), length, false);
+            });
+        }
+    }
+
+    /*!
+     * Finds the groups within @a matched that earn a special rune: lines of five or more first,
+     * then crossing runs (L, T and cross), then lines of four. A gem counts towards one group at
+     * most. Lines come out of a few shifts per gem type and every crossing is told apart by how
+     * many of its row and column neighbours match, looked up in a table, so the cost stays
+     * bounded by the board size however the runs lie.
+     *
+     * @param matched the result of @a findMatches
+     * @param preferred cells the special rune forms on when a group covers one, such as the two
+     *     cells of the swap that caused the match; otherwise it forms mid-line or at the crossing
+     * @return the number of groups written to @a outShapes
+     */
+    int findShapes(const Mask &matched, const Mask &preferred, ShapeList &outShapes) const {
+        outShapes.count = 0;
+        Mask used{};
+        auto add = [&](MatchShape shape, int type, const Mask &group, int fallbackCell,
+                       bool horizontal) {
+            if ((group & used).any()) {
+                return;
+            }
+            used |= group;
+            const Mask preferredCells = group & preferred;
+            ShapeMatch &match = outShapes.shapes[outShapes.count++];
+            match.shape = shape;
+            match.type = static_cast<GemType>(type);
+            match.cell = static_cast<uint8_t>(
+                    preferredCells.any() ? preferredCells.lowest() : fallbackCell);
+            match.horizontal = horizontal;
+        };
+
+        const auto &tables = bitboard::kBoardTables<Rows, Cols>;
+        for (int type = 0; type < GemTypes; ++type) {
+            const Mask gems = gems_[type] & matched;
+            if (gems.none()) {
+                continue;
+            }
+            const Mask horizontal = horizontalRuns(gems);
+            const Mask vertical = verticalRuns(gems);
+
+            // where runs of four and five start; a longer run has one start per extra gem
+            const Mask pairs = horizontal & (horizontal >> 1);
+            const Mask horizontal4 = pairs & (pairs >> 2) & tables.horizontalRun4Starts;
+            const Mask horizontal5 = horizontal4 & (horizontal4 >> 1);
+            const Mask columnPairs = vertical & (vertical >> Cols);
+            const Mask vertical4 = columnPairs & (columnPairs >> (2 * Cols));
+            const Mask vertical5 = vertical4 & (vertical4 >> Cols);
+
+            (horizontal5 & ~(horizontal5 << 1)).forEach([&](int head) {
+                add(MatchShape::Line5, type, runThrough(horizontal, head, true), head + 2, true);
+            });
+            (vertical5 & ~(vertical5 << Cols)).forEach([&](int head) {
+                add(MatchShape::Line5, type, runThrough(vertical, head, false), head + 2 * Cols,
+                    false);
+            });
+
+            (horizontal & vertical).forEach([&](int cell) {
+                const int rowArms = (horizontal & tables.rowNeighbours[cell]).count();
+                const int columnArms = (vertical & tables.columnNeighbours[cell]).count();
+                add(kCrossingShapes[rowArms][columnArms], type,
+                    runThrough(horizontal, cell, true) | runThrough(vertical, cell, false), cell,
+                    false);
+            });
+
+            (horizontal4 & ~(horizontal4 << 1)).forEach([&](int head) {
+                add(MatchShape::Line4, type, runThrough(horizontal, head, true), head + 1, true);
+            });
+            (vertical4 & ~(vertical4 << Cols)).forEach([&](int head) {
+                add(MatchShape::Line4, type, runThrough(vertical, head, false), head + Cols,
+                    false);
+            });
+        }
+        return outShapes.count;
+    }
+
+    /*!
+     * Adds to @a cleared everything the special runes caught in it clear, and everything the
+     * runes caught in that clear, until no new rune is caught.
+     */
+    Mask withBlasts(const Mask &cleared) const {
+        const auto &tables = bitboard::kBoardTables<Rows, Cols>;
+        const Mask gems = occupied();
+        Mask result = cleared;
+        Mask pending = cleared & specialCells_;
+        while (pending.any()) {
+            const int cell = pending.lowest();
+            pending.reset(cell);
+            Mask blast{};
+            switch (static_cast<SpecialRune>(specials_[cell])) {
+                case SpecialRune::RowBlast:
+                    blast = tables.rows[rowOf(cell)];
+                    break;
+                case SpecialRune::ColumnBlast:
+                    blast = tables.columns[columnOf(cell)];
+                    break;
+                case SpecialRune::Bomb:
+                    blast = tables.blastAreas[cell];
+                    break;
+                case SpecialRune::Prism:
+                    blast = gems_[cells_[cell]];
+                    break;
+                case SpecialRune::None:
+                    break;
+            }
+            blast = blast & gems;
+            pending |= blast & ~result & specialCells_;
+            result |= blast;
+        }
+        return result;
+    }
+
+    /*!
+     * What a scan's @a matched cells clear once special runes are in play: the groups that earn a
+     * rune are written to @a outShapes as by @a findShapes, the runes caught are set off as by
+     * @a withBlasts, and the gems turning special stay on the board.
+     */
+    Mask resolveSpecials(const Mask &matched, const Mask &preferred, ShapeList &outShapes) const {
+        findShapes(matched, preferred, outShapes);
+        Mask formed{};
+        for (int i = 0; i < outShapes.count; ++i) {
+            formed.set(outShapes.shapes[i].cell);
+        }
+        return withBlasts(matched) & ~formed;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Gravity
+
+    /*!
+     * Where the last gravity pass moved the gems, as per-cell fall distances an animation can
+     * play back directly.
+     */
+    struct Gravity {
+        //! rows the gem now in each cell fell; refilled cells count from above the top edge
+        std::array<uint8_t, kCells> fallRows{};
+        //! cells holding a gem that fell from higher up the column
+        Mask moved{};
+        //! cells holding a new gem
+        Mask refilled{};
+    };
+
+    /*!
+     * Lets every gem fall to the lowest free cell of its column and fills the cells left at the
+     * top. Each column with a gap is compacted in one go from its occupancy bits, which give the
+     * fall distance of every cell at once. Changed cells are marked dirty.
+     *
+     * @param nextGem called as nextGem(column) -> GemType for every refilled cell, columns left
+     *     to right and the bottom-most cell of each column first
+     * @param outGravity if given, receives the fall distances
+     */
+    template<typename NextGem>
+    void applyGravityAndFill(NextGem &&nextGem, Gravity *outGravity = nullptr) {
+        if (outGravity) {
+            *outGravity = Gravity{};
+        }
+        const Mask gaps = ~occupied();
+        if (gaps.none()) {
+            return;
+        }
+
+        std::array<uint32_t, Cols> columnGaps{};
+        gaps.forEach([&](int index) {
+            columnGaps[columnOf(index)] |= 1U << rowOf(index);
+        });
+
+        constexpr uint32_t kColumnBits = Rows == 32 ? ~0U : (1U << Rows) - 1;
+        // special runes fall with their gems
+        const bool carrySpecials = specialCells_.any();
+        for (int col = 0; col < Cols; ++col) {
+            if (columnGaps[col] == 0) {
+                continue;
+            }
+            const auto column = bitboard::columnFall<Rows>(kColumnBits & ~columnGaps[col]);
+
+            // bottom up, so every source is read before anything lands on it
+            for (int row = Rows - 1; row >= column.refills; --row) {
+                const int fall = column.fall[row];
+                if (fall == 0) {
+                    continue;
+                }
+                const int index = cellIndex(row, col);
+                setCell(index, cells_[index - fall * Cols]);
+                if (carrySpecials) {
+                    setSpecialCell(index, specials_[index - fall * Cols]);
+                }
+                if (outGravity) {
+                    outGravity->fallRows[index] = static_cast<uint8_t>(fall);
+                    outGravity->moved.set(index);
+                }
+            }
+            for (int row = column.refills - 1; row >= 0; --row) {
+                const int index = cellIndex(row, col);
+                setCell(index, static_cast<uint8_t>(nextGem(col)));
+                if (carrySpecials) {
+                    setSpecialCell(index, 0);
+                }
+                if (outGravity) {
+                    outGravity->fallRows[index] = column.refills;
+                    outGravity->refilled.set(index);
+                }
+            }
+
+            dirty_.rows |= column.changedRows;
+            dirty_.columns |= 1U << col;
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Moves
+
+    /*!
+     * @return true if swapping the gems in cells @a first and @a second completes a run of three.
+     *     Decided with a handful of window tests around the two cells; nothing is swapped or
+     *     rescanned. The cells must be adjacent.
+     */
+    bool isLegalSwap(int first, int second) const {
+        const uint8_t firstType = cells_[first];
+        const uint8_t secondType = cells_[second];
+        if (firstType == kEmptyCell || secondType == kEmptyCell || firstType == secondType) {
+            return false;
+        }
+
+        // both masks lose one cell and gain the other, which is the same toggle for each of them
+        const Mask swapBits = Mask::bit(first) | Mask::bit(second);
+        return completesRun(gems_[secondType] ^ swapBits, first) ||
+               completesRun(gems_[firstType] ^ swapBits, second);
+    }
+
+    /*!
+     * Lists every legal swap into @a outMoves.
+     * @return the number of legal swaps found
+     */
+    int findLegalMoves(MoveList &outMoves) const {
+        outMoves.count = 0;
+        forEachAdjacentPair([&](int first, int second) {
+            if (isLegalSwap(first, second)) {
+                Move &move = outMoves.moves[outMoves.count++];
+                move.from = static_cast<uint8_t>(first);
+                move.to = static_cast<uint8_t>(second);
+            }
+            return false;
+        });
+        return outMoves.count;
+    }
+
+    /*!
+     * Same as @a findLegalMoves but stops at the first legal swap.
+     */
+    bool hasLegalMove() const {
+        return forEachAdjacentPair([&](int first, int second) {
+            return isLegalSwap(first, second);
+        });
+    }
+
+    /*!
+     * Picks the legal swap that clears the most gems immediately, preferring the earliest one on
+     * ties so the hint is stable between frames.
+     * @return false if the board has no legal swap
+     */
+    bool findHint(Move &outMove) const {
+        MoveList moves;
+        if (findLegalMoves(moves) == 0) {
+            return false;
+        }
+
+        int bestScore = -1;
+        for (int i = 0; i < moves.count; ++i) {
+            BoardEngine swapped = *this;
+            swapped.swapCells(moves.moves[i].from, moves.moves[i].to);
+            const int score = swapped.findMatches().count();
+            if (score > bestScore) {
+                bestScore = score;
+                outMove = moves.moves[i];
+            }
+        }
+        return true;
+    }
+
+    /*!
+     * Rearranges the gems in place. The number of gems of every type and the set of occupied
+     * cells are preserved, the result has no run of three and at least one legal swap. Special
+     * runes stay on their cells and take on the gem dealt there. The board is left untouched if
+     * no such layout was found within a bounded number of attempts.
+     * @return true if the board was reshuffled
+     */
+    template<typename Rng>
+    bool reshuffle(Rng &rng) {
+        const Mask occupiedCells = occupied();
+        std::array<int, GemTypes> totals{};
+        for (int type = 0; type < GemTypes; ++type) {
+            totals[type] = gems_[type].count();
+        }
+
+        for (int attempt = 0; attempt < kMaxReshuffleAttempts; ++attempt) {
+            BoardEngine candidate;
+            std::array<int, GemTypes> remaining = totals;
+            bool placedAll = true;
+
+            // Fill the occupied cells in order, drawing each gem from what is left and skipping
+            // any type that would complete a run with the cells placed so far.
+            occupiedCells.forEach([&](int cell) {
+                if (!placedAll) {
+                    return;
+                }
+                std::array<int, GemTypes> weights{};
+                int totalWeight = 0;
+                for (int type = 0; type < GemTypes; ++type) {
+                    if (remaining[type] > 0 &&
+                        !completesRun(candidate.gems_[type] | Mask::bit(cell), cell)) {
+                        weights[type] = remaining[type];
+                        totalWeight += remaining[type];
+                    }
+                }
+                if (totalWeight == 0) {
+                    placedAll = false;
+                    return;
+                }
+
+                int pick = randomInt(rng, 0, totalWeight - 1);
+                int type = 0;
+                while (pick >= weights[type]) {
+                    pick -= weights[type];
+                    ++type;
+                }
+                candidate.setCell(cell, static_cast<uint8_t>(type));
+                --remaining[type];
+            });
+
+            if (placedAll && candidate.hasLegalMove()) {
+                gems_ = candidate.gems_;
+                cells_ = candidate.cells_;
+                markAllDirty();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Generation
+
+    /*!
+     * Replaces the board with a full, match-free layout in a single pass: every cell draws from
+     * the gem types that would not complete a run with the cells already placed, so there is no
+     * generate-and-reject loop.
+     *
+     * @param rng the random source; the same generator state always produces the same board
+     * @param minLegalMoves the number of distinct legal swaps the board must offer. That many
+     *     swap patterns are planted before the fill and the result is counted to confirm it; if a
+     *     few planted boards fall short, plain match-free fills are dealt until one offers enough,
+     *     so this must stay within what a match-free board can offer.
+     */
+    template<typename Rng>
+    void generate(Rng &rng, int minLegalMoves = 1) {
+        for (int attempt = 0; attempt < kMaxGenerateAttempts; ++attempt) {
+            clear();
+            Mask reserved{};
+            for (int i = 0; i < minLegalMoves; ++i) {
+                if (!plantMove(reserved, rng)) {
+                    break;
+                }
+            }
+
+            if (!fillRemaining(occupied(), rng)) {
+                continue;
+            }
+
+            MoveList moves;
+            if (findLegalMoves(moves) >= minLegalMoves) {
+                markAllDirty();
+                return;
+            }
+        }
+
+        // Without planted gems only the cells to the left and above are filled when a cell is
+        // chosen, which rules out at most two types, so this pass always fills the board; most
+        // such boards offer plenty of swaps, so few are dealt before one offers enough.
+        MoveList moves;
+        do {
+            clear();
+            fillRemaining(Mask{}, rng);
+        } while (findLegalMoves(moves) < minLegalMoves);
+        markAllDirty();
+    }
+
+    /*!
+     * Seeded convenience overload for reproducible boards.
+     */
+    void generate(uint32_t seed, int minLegalMoves = 1) {
+        std::mt19937 rng(seed);
+        generate(rng, minLegalMoves);
+    }
+
+    /*!
+     * Draws an integer in [@a minValue, @a maxValue] from a generator of 32-bit values by scaling
+     * rather than through std::uniform_int_distribution, whose algorithm differs between standard
+     * libraries. Seeded boards and games therefore come out the same on device and on the host.
+     */
+    template<typename Rng>
+    static int randomInt(Rng &rng, int minValue, int maxValue) {
+        const uint64_t range = static_cast<uint64_t>(maxValue - minValue) + 1;
+        const uint64_t draw = static_cast<uint32_t>(rng());
+        return minValue + static_cast<int>((draw * range) >> 32);
+    }
+
+private:
+    //! how many fresh layouts @a reshuffle tries before giving up
+    static constexpr int kMaxReshuffleAttempts = 64;
+    //! how often a single planted swap pattern is re-rolled when it lands on reserved cells
+    static constexpr int kMaxPlantAttempts = 16;
+    //! planting can box a cell in, so a layout is retried a few times before a plain fill
+    static constexpr int kMaxGenerateAttempts = 8;
+
+    inline void setCell(int index, uint8_t type) {
+        const uint8_t previous = cells_[index];
+        if (previous != kEmptyCell) {
+            gems_[previous].reset(index);
+        }
+        if (type != kEmptyCell) {
+            gems_[type].set(index);
+        }
+        cells_[index] = type;
+    }
+
+    inline void setSpecialCell(int index, uint8_t special) {
+        specials_[index] = special;
+        if (special != 0) {
+            specialCells_.set(index);
+        } else {
+            specialCells_.reset(index);
+        }
+    }
+
+    inline void markAllDirty() {
+        dirty_.rows = Rows == 32 ? ~0U : (1U << Rows) - 1;
+        dirty_.columns = Cols == 32 ? ~0U : (1U << Cols) - 1;
+    }
+
+    static inline Mask horizontalRuns(const Mask &gems) {
+        const Mask starts = gems & (gems >> 1) & (gems >> 2) &
+                            bitboard::kBoardTables<Rows, Cols>.horizontalRunStarts;
+        return starts | (starts << 1) | (starts << 2);
+    }
+
+    /*!
+     * @return the cells of the run in @a runs that passes through @a cell along a row or a column
+     */
+    static inline Mask runThrough(const Mask &runs, int cell, bool horizontal) {
+        const int step = horizontal ? 1 : Cols;
+        const int length = horizontal ? Cols : Rows;
+        const int position = horizontal ? columnOf(cell) : rowOf(cell);
+        Mask run = Mask::bit(cell);
+        for (int i = position - 1; i >= 0 && runs.test(cell - (position - i) * step); --i) {
+            run.set(cell - (position - i) * step);
+        }
+        for (int i = position + 1; i < length && runs.test(cell + (i - position) * step); ++i) {
+            run.set(cell + (i - position) * step);
+        }
+        return run;
+    }
+
+    static inline Mask verticalRuns(const Mask &gems) {
+        const Mask starts = gems & (gems >> Cols) & (gems >> (2 * Cols));
+        return starts | (starts << Cols) | (starts << (2 * Cols));
+    }
+
+    /*!
+     * @return true if @a gems holds a complete run of three through @a cell
+     */
+    static inline bool completesRun(const Mask &gems, int cell) {
+        const auto &entry = bitboard::kBoardTables<Rows, Cols>.windows[cell];
+        for (int i = 0; i < entry.count; ++i) {
+            if ((gems & entry.windows[i]) == entry.windows[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*!
+     * Calls @a visit(first, second) for every orthogonally adjacent pair of cells; returns early
+     * when the visitor returns true.
+     */
+    template<typename Visitor>
+    static bool forEachAdjacentPair(Visitor &&visit) {
+        for (int row = 0; row < Rows; ++row) {
+            for (int col = 0; col < Cols; ++col) {
+                const int cell = cellIndex(row, col);
+                if (col + 1 < Cols && visit(cell, cell + 1)) {
+                    return true;
+                }
+                if (row + 1 < Rows && visit(cell, cell + Cols)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+
+    /*!
+     * Places two gems of one type in a line plus a third gem of that type beside the gap, so
+     * swapping the third gem into the gap completes the line. The gap itself is left for the
+     * fill, which can never give it the planted type because that would complete the run.
+     *
+     * @param reserved cells already used by earlier patterns, including their gaps
+     * @return true if a pattern was placed
+     */
+    template<typename Rng>
+    bool plantMove(Mask &reserved, Rng &rng) {
+        for (int attempt = 0; attempt < kMaxPlantAttempts; ++attempt) {
+            const bool horizontal = randomInt(rng, 0, 1) == 0;
+            const int gap = randomInt(rng, 0, 2);
+            const int side = randomInt(rng, 0, 1) == 0 ? -1 : 1;
+            const int type = randomInt(rng, 0, GemTypes - 1);
+
+            Mask lineCells{};
+            int gapCell = 0;
+            int moverCell = 0;
+            if (horizontal) {
+                const int row = side < 0 ? randomInt(rng, 1, Rows - 1)
+                                         : randomInt(rng, 0, Rows - 2);
+                const int start = randomInt(rng, 0, Cols - 3);
+                for (int i = 0; i < 3; ++i) {
+                    lineCells.set(cellIndex(row, start + i));
+                }
+                gapCell = cellIndex(row, start + gap);
+                moverCell = cellIndex(row + side, start + gap);
+            } else {
+                const int col = side < 0 ? randomInt(rng, 1, Cols - 1)
+                                         : randomInt(rng, 0, Cols - 2);
+                const int start = randomInt(rng, 0, Rows - 3);
+                for (int i = 0; i < 3; ++i) {
+                    lineCells.set(cellIndex(start + i, col));
+                }
+                gapCell = cellIndex(start + gap, col);
+                moverCell = cellIndex(start + gap, col + side);
+            }
+
+            const Mask gapBit = Mask::bit(gapCell);
+            const Mask gemCells = (lineCells & ~gapBit) | Mask::bit(moverCell);
+            if ((gemCells | gapBit) & reserved) {
+                continue;
+            }
+
+            const Mask placed = gems_[type] | gemCells;
+            bool formsRun = false;
+            gemCells.forEach([&](int cell) {
+                formsRun = formsRun || completesRun(placed, cell);
+            });
+            if (formsRun) {
+                continue;
+            }
+
+            gemCells.forEach([&](int cell) {
+                setCell(cell, static_cast<uint8_t>(type));
+            });
+            reserved |= gemCells | gapBit;
+            return true;
+        }
+        return false;
+    }
+
+    /*!
+     * Gives every cell outside @a planted a gem that does not complete a run.
+     * @return false if some cell had no such gem left (only possible next to planted cells)
+     */
+    template<typename Rng>
+    bool fillRemaining(const Mask &planted, Rng &rng) {
+        bool clean = true;
+        (~planted).forEach([&](int cell) {
+            std::array<int, GemTypes> allowed{};
+            int allowedCount = 0;
+            for (int type = 0; type < GemTypes; ++type) {
+                if (!completesRun(gems_[type] | Mask::bit(cell), cell)) {
+                    allowed[allowedCount++] = type;
+                }
+            }
+
+            int type = 0;
+            if (allowedCount > 0) {
+                type = allowed[randomInt(rng, 0, allowedCount - 1)];
+            } else {
+                clean = false;
+                type = randomInt(rng, 0, GemTypes - 1);
+            }
+            setCell(cell, static_cast<uint8_t>(type));
+        });
+        return clean;
+    }
+
+    /*!
+     * The shape of a crossing, by how many of its row neighbours and column neighbours are in the
+     * runs: one means the crossing ends that run, two that it lies inside it.
+     */
+    static constexpr MatchShape kCrossingShapes[3][3] = {
+            {MatchShape::L, MatchShape::L, MatchShape::L},
+            {MatchShape::L, MatchShape::L, MatchShape::T},
+            {MatchShape::L, MatchShape::T, MatchShape::Cross},
+    };
+
+    std::array<Mask, GemTypes> gems_{};
+    std::array<uint8_t, kCells> cells_{};
+    //! the SpecialRune on each cell
+    std::array<uint8_t, kCells> specials_{};
+    Mask specialCells_{};
+    DirtyLines dirty_;
+};
+
+typedef BoardEngine<8, 5, 4> Board8x5;
+typedef BoardEngine<9, 9, 4> Board9x9;
+typedef BoardEngine<16, 16, 4> Board16x16;
+
+//! The board the game currently plays on.
+typedef Board8x5 GameBoard;
+
+// a member that owned heap memory would stop these from being trivially copyable, so they stay
+// inline; runebound-sim --check-allocs asserts that resolving matches never allocates
+static_assert(std::is_trivially_copyable_v<GameBoard> &&
+              std::is_trivially_copyable_v<GameBoard::MatchResult>,
+              "the board and its match results keep all their storage inline");
+
+extern template class BoardEngine<8, 5, 4>;
+extern template class BoardEngine<9, 9, 4>;
+extern template class BoardEngine<16, 16, 4>;
+
+#endif //ANDROIDGLINVESTIGATIONS_BOARDENGINE_H
@@ -0,0 +1,98 @@
+#include "CombatEvents.h"
+
+namespace {
+
+constexpr int kKindShift = 0;
+constexpr int kElementShift = 8;
+constexpr int kSpawnShift = 16;
+constexpr int kAmountShift = 32;
+constexpr int kValueShift = 48;
+
+inline uint64_t packHeader(const CombatEvent &event) {
+    return static_cast<uint64_t>(event.kind) << kKindShift |
+           static_cast<uint64_t>(event.element) << kElementShift |
+           static_cast<uint64_t>(event.spawn) << kSpawnShift |
+           static_cast<uint64_t>(static_cast<uint16_t>(event.amount)) << kAmountShift |
+           static_cast<uint64_t>(static_cast<uint16_t>(event.value)) << kValueShift;
+}
+
+inline void unpackHeader(uint64_t header, CombatEvent &outEvent) {
+    outEvent.kind = static_cast<CombatEventKind>(static_cast<uint8_t>(header >> kKindShift));
+    outEvent.element = static_cast<uint8_t>(header >> kElementShift);
+    outEvent.spawn = static_cast<ElementSpawn>(static_cast<uint8_t>(header >> kSpawnShift));
+    outEvent.amount = static_cast<int16_t>(static_cast<uint16_t>(header >> kAmountShift));
+    outEvent.value = static_cast<int16_t>(static_cast<uint16_t>(header >> kValueShift));
+}
+
+} // namespace
+
+void CombatEventRing::push(CombatEventKind kind,
+                           int element,
+                           int amount,
+                           int value,
+                           ElementSpawn spawn,
+                           const GameBoard::Mask &cells) {
+    const uint32_t sequence = next_.load(std::memory_order_relaxed);
+    CombatEvent event;
+    event.kind = kind;
+    event.element = static_cast<uint8_t>(element);
+    event.spawn = spawn;
+    event.amount = static_cast<int16_t>(amount);
+    event.value = static_cast<int16_t>(value);
+
+    Slot &slot = slots_[sequence & (kCapacity - 1)];
+    slot.sequence.store(kBusy, std::memory_order_relaxed);
+    // readers that see the new payload must also see the slot marked busy
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.header.store(packHeader(event), std::memory_order_relaxed);
+    slot.cells.store(cells.words[0], std::memory_order_relaxed);
+    slot.sequence.store(sequence, std::memory_order_release);
+    next_.store(sequence + 1, std::memory_order_release);
+}
+
+void CombatEventRing::pushMatches(const ElementEffectTable &effects,
+                                  const GameBoard::MatchResult &matches,
+                                  const CombatStats &stats) {
+    for (int type = 0; type < GameBoard::kGemTypes; ++type) {
+        const int count = matches.clearedByType[type].count();
+        if (count == 0) {
+            continue;
+        }
+        if (effects.damage[type] != 0) {
+            push(CombatEventKind::Damage, type, count * effects.damage[type], stats.enemyHP);
+        }
+        if (effects.heal[type] != 0) {
+            push(CombatEventKind::Heal, type, count * effects.heal[type], stats.heroHP);
+        }
+        if (effects.shield[type] != 0) {
+            push(CombatEventKind::Shield, type, count * effects.shield[type], stats.heroShield);
+        }
+        if (effects.spawn[type] != ElementSpawn::None) {
+            push(CombatEventKind::Spawn, type, count, 0, effects.spawn[type],
+                 matches.clearedByType[type]);
+        }
+    }
+}
+
+void CombatEventRing::pushState(GameState state) {
+    push(CombatEventKind::State, CombatEvent::kNoElement, 0, static_cast<int>(state));
+}
+
+bool CombatEventRing::read(uint32_t sequence, CombatEvent &outEvent) const {
+    const Slot &slot = slots_[sequence & (kCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+        return false;
+    }
+    const uint64_t header = slot.header.load(std::memory_order_relaxed);
+    const uint64_t cells = slot.cells.load(std::memory_order_relaxed);
+    // the payload must be read before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+        return false;
+    }
+    outEvent.sequence = sequence;
+    unpackHeader(header, outEvent);
+    outEvent.cells = GameBoard::Mask{};
+    outEvent.cells.words[0] = cells;
+    return true;
+}
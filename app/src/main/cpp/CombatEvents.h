@@ -0,0 +1,154 @@
+#ifndef ANDROIDGLINVESTIGATIONS_COMBATEVENTS_H
+#define ANDROIDGLINVESTIGATIONS_COMBATEVENTS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "GameSession.h"
+
+/*!
+ * What a single @a CombatEvent reports.
+ */
+enum class CombatEventKind : uint8_t {
+    //! @a element's gems dealt @a amount damage; @a value is the enemy's hit points after the step
+    Damage,
+    //! @a element's gems healed @a amount; @a value is the hero's hit points after the step
+    Heal,
+    //! @a element's gems gave @a amount shield; @a value is the hero's shield after the step
+    Shield,
+    //! @a element's matched @a cells call for the visual @a spawn
+    Spawn,
+    //! the battle is now in @a GameState @a value, as after a start, a restore or its last blow
+    State,
+};
+
+/*!
+ * One thing that happened in combat, as a damage-number overlay or an effects layer wants it.
+ * Amounts are an element's share before the stats were clamped; values are where the stat ended
+ * up once the whole cascade step was applied. Sequence numbers count up by one per event.
+ */
+struct CombatEvent {
+    uint32_t sequence = 0;
+    CombatEventKind kind = CombatEventKind::State;
+    //! a GemType, or kNoElement for State events
+    uint8_t element = 0;
+    ElementSpawn spawn = ElementSpawn::None;
+    int16_t amount = 0;
+    int16_t value = 0;
+    //! the matched cells of @a element in Spawn events
+    GameBoard::Mask cells{};
+
+    static constexpr uint8_t kNoElement = 0xFF;
+};
+
+static_assert(GameBoard::kCells <= 64, "an event carries its cells in one word");
+
+/*!
+ * The newest combat events of one session in a fixed ring. One thread appends; any number of
+ * consumers on any threads read at their own pace, each with its own cursor, without locks and
+ * without holding the producer back. A consumer that falls a whole ring behind loses the oldest
+ * events and is told how many.
+ *
+ * Every slot is a small seqlock: the producer marks it busy, writes the payload and then stamps
+ * it with the event's sequence, so a reader can tell a finished event from one being overwritten.
+ */
+class CombatEventRing {
+public:
+    //! events kept; a long cascade emits a few per step
+    static constexpr uint32_t kCapacity = 256;
+
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "the ring wraps with a mask");
+
+    /*!
+     * Where one consumer stands in the stream.
+     */
+    struct Cursor {
+        //! the sequence read next
+        uint32_t next = 0;
+        //! events overwritten before this consumer got to them, over its lifetime
+        uint64_t dropped = 0;
+    };
+
+    //! the sequence the next event will get; producer only
+    inline uint32_t nextSequence() const { return next_.load(std::memory_order_relaxed); }
+
+    //! the sequence the next event will get, as published to consumers
+    inline uint32_t publishedSequence() const { return next_.load(std::memory_order_acquire); }
+
+    //! producer only; never blocks
+    void push(CombatEventKind kind,
+              int element,
+              int amount,
+              int value,
+              ElementSpawn spawn = ElementSpawn::None,
+              const GameBoard::Mask &cells = GameBoard::Mask{});
+
+    //! the Damage, Heal, Shield and Spawn events of one cascade step
+    void pushMatches(const ElementEffectTable &effects,
+                     const GameBoard::MatchResult &matches,
+                     const CombatStats &stats);
+
+    void pushState(GameState state);
+
+    //! moves @a cursor to the newest event, skipping everything before it
+    inline void seekToEnd(Cursor &cursor) const { cursor.next = publishedSequence(); }
+
+    /*!
+     * Calls @a visit(const CombatEvent &) for every event published since @a cursor, but not for
+     * those from @a end on, and moves @a cursor past them. Events overwritten before they were
+     * read are skipped and counted in @a Cursor::dropped.
+     * @return the number of events visited
+     */
+    template<typename Visitor>
+    int poll(Cursor &cursor, uint32_t end, Visitor &&visit) const {
+        int visited = 0;
+        const uint32_t published = publishedSequence();
+        if (static_cast<int32_t>(end - published) > 0) {
+            end = published;
+        }
+        while (static_cast<int32_t>(end - cursor.next) > 0) {
+            CombatEvent event;
+            if (!read(cursor.next, event)) {
+                // lapped: start again from the oldest event the ring can still hold
+                const uint32_t oldest = publishedSequence() - kCapacity + 1;
+                const uint32_t resume = static_cast<int32_t>(oldest - cursor.next) > 0
+                                        ? oldest : cursor.next + 1;
+                cursor.dropped += resume - cursor.next;
+                cursor.next = resume;
+                continue;
+            }
+            visit(event);
+            ++visited;
+            ++cursor.next;
+        }
+        return visited;
+    }
+
+    //! as @a poll, up to everything published so far
+    template<typename Visitor>
+    inline int poll(Cursor &cursor, Visitor &&visit) const {
+        return poll(cursor, publishedSequence(), visit);
+    }
+
+private:
+    //! marks a slot whose payload is being written
+    static constexpr uint32_t kBusy = 0xFFFFFFFFU;
+
+    /*!
+     * An event split into words that can be read while the producer rewrites them.
+     */
+    struct Slot {
+        std::atomic<uint32_t> sequence{kBusy};
+        std::atomic<uint64_t> header{0};
+        std::atomic<uint64_t> cells{0};
+    };
+
+    //! @return false if the event with @a sequence is no longer, or not yet, in its slot
+    bool read(uint32_t sequence, CombatEvent &outEvent) const;
+
+    std::array<Slot, kCapacity> slots_;
+    std::atomic<uint32_t> next_{0};
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_COMBATEVENTS_H
@@ -0,0 +1,134 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ELEMENTEFFECTS_H
+#define ANDROIDGLINVESTIGATIONS_ELEMENTEFFECTS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "BoardEngine.h"
+
+/*!
+ * The hero the player fights with, in the order of the Kotlin HeroClass enum.
+ */
+enum class HeroClass : uint8_t {
+    Warrior,
+    Mage,
+    Ranger,
+    Priestess,
+    Count,
+};
+
+static constexpr int kHeroClassCount = static_cast<int>(HeroClass::Count);
+
+/*!
+ * The visual effect a matched element leaves on screen. Gameplay never looks at it.
+ */
+enum class ElementSpawn : uint8_t {
+    None,
+    WindSwirl,
+    Embers,
+    Droplets,
+    Shards,
+    Count,
+};
+
+static constexpr int kElementSpawnCount = static_cast<int>(ElementSpawn::Count);
+
+/*!
+ * What one cleared gem of each element does, one array per effect so a cascade step's totals
+ * are a dot product with its per-element gem counts.
+ */
+struct ElementEffectTable {
+    typedef std::array<int32_t, GameBoard::kGemTypes> Values;
+
+    //! hit points the enemy loses
+    Values damage{};
+    //! hit points the hero regains
+    Values heal{};
+    //! shield the hero gains
+    Values shield{};
+    std::array<ElementSpawn, GameBoard::kGemTypes> spawn{};
+};
+
+/*!
+ * How a hero class turns an element's base value into effects, in percent of that value.
+ */
+struct ElementScale {
+    int16_t damagePercent;
+    int16_t healPercent;
+    int16_t shieldPercent;
+    ElementSpawn spawn;
+};
+
+typedef std::array<ElementScale, GameBoard::kGemTypes> HeroElementScales;
+
+static_assert(GameBoard::kGemTypes == 4, "one scale per element: fire, water, air, earth");
+
+/*!
+ * Every class's scales, indexed by HeroClass then GemType. The warrior plays the base values
+ * unchanged; the others trade strength in one element for weakness in another, and some elements
+ * spill into a second effect.
+ */
+static constexpr std::array<HeroElementScales, kHeroClassCount> kHeroElementScales = {{
+        // Warrior
+        {{{100, 0, 0, ElementSpawn::Embers},
+          {0, 100, 0, ElementSpawn::Droplets},
+          {100, 0, 0, ElementSpawn::WindSwirl},
+          {0, 0, 100, ElementSpawn::Shards}}},
+        // Mage: runes of fire and air hit harder, earth holds less
+        {{{130, 0, 0, ElementSpawn::Embers},
+          {0, 100, 0, ElementSpawn::Droplets},
+          {125, 0, 0, ElementSpawn::WindSwirl},
+          {0, 0, 70, ElementSpawn::Shards}}},
+        // Ranger: air volleys dominate and also cover the ranger with a little shield
+        {{{90, 0, 0, ElementSpawn::Embers},
+          {0, 90, 0, ElementSpawn::Droplets},
+          {175, 0, 25, ElementSpawn::WindSwirl},
+          {0, 0, 90, ElementSpawn::Shards}}},
+        // Priestess: water heals and shields, earth shields more, attacks are weaker
+        {{{75, 0, 0, ElementSpawn::Embers},
+          {0, 150, 25, ElementSpawn::Droplets},
+          {75, 0, 0, ElementSpawn::WindSwirl},
+          {0, 0, 125, ElementSpawn::Shards}}},
+}};
+
+/*!
+ * Builds the effect table for @a heroClass from the per-gem base value of each element, in
+ * GemType order. Fractions round towards zero.
+ */
+constexpr ElementEffectTable makeElementEffects(const ElementEffectTable::Values &baseValues,
+                                                HeroClass heroClass) {
+    ElementEffectTable table;
+    const HeroElementScales &scales = kHeroElementScales[static_cast<int>(heroClass)];
+    for (int type = 0; type < GameBoard::kGemTypes; ++type) {
+        table.damage[type] = baseValues[type] * scales[type].damagePercent / 100;
+        table.heal[type] = baseValues[type] * scales[type].healPercent / 100;
+        table.shield[type] = baseValues[type] * scales[type].shieldPercent / 100;
+        table.spawn[type] = scales[type].spawn;
+    }
+    return table;
+}
+
+//! lower-case class names, as host tools print and accept them
+static constexpr std::array<const char *, kHeroClassCount> kHeroClassNames = {
+        "warrior", "mage", "ranger", "priestess",
+};
+
+inline const char *heroClassName(HeroClass heroClass) {
+    return kHeroClassNames[static_cast<int>(heroClass)];
+}
+
+/*!
+ * @return false, leaving @a outClass unchanged, if @a name is not one of @a kHeroClassNames
+ */
+inline bool parseHeroClass(const char *name, HeroClass &outClass) {
+    for (int heroClass = 0; heroClass < kHeroClassCount; ++heroClass) {
+        if (std::strcmp(name, kHeroClassNames[heroClass]) == 0) {
+            outClass = static_cast<HeroClass>(heroClass);
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif //ANDROIDGLINVESTIGATIONS_ELEMENTEFFECTS_H
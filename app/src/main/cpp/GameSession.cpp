@@ -0,0 +1,565 @@
+#include "GameSession.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iterator>
+
+#include "BinaryStream.h"
+#include "BoardDelta.h"
+#include "CombatEvents.h"
+
+/*!
+ * When enabled, every incremental (dirty-line) match scan is compared against a full board scan and
+ * any disagreement is asserted. On by default in debug builds; pass -DRUNEBOUND_MATCH_CROSSCHECK=0
+ * or 1 to override.
+ */
+#ifndef RUNEBOUND_MATCH_CROSSCHECK
+#ifdef NDEBUG
+#define RUNEBOUND_MATCH_CROSSCHECK 0
+#else
+#define RUNEBOUND_MATCH_CROSSCHECK 1
+#endif
+#endif
+
+static constexpr uint8_t kSnapshotMagic[4] = {'R', 'B', 'S', 'S'};
+//! version 2: refill weights and the partly used refill draw
+//! version 3: special runes and whether they are enabled
+//! version 4: the rules byte also says whether refills are pre-rolled; the refill queues
+//! version 5: the hero class
+static constexpr uint8_t kSnapshotVersion = 5;
+//! bits of the rules byte that follows the refill weights
+static constexpr uint8_t kRuleSpecialRunes = 1U << 0;
+static constexpr uint8_t kRulePrerolledRefills = 1U << 1;
+
+/*!
+ * Writes the little-endian layout @a ByteReader reads straight into a snapshot, so saving one never
+ * touches the heap.
+ */
+struct SnapshotWriter {
+    uint8_t *out;
+    size_t position = 0;
+
+    void u8(uint8_t value) {
+        out[position++] = value;
+    }
+
+    void u16(uint16_t value) {
+        u8(static_cast<uint8_t>(value));
+        u8(static_cast<uint8_t>(value >> 8));
+    }
+
+    void u32(uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            u8(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void i16(int value) {
+        u16(static_cast<uint16_t>(static_cast<int16_t>(value)));
+    }
+
+    void bytes(const uint8_t *data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            u8(data[i]);
+        }
+    }
+};
+
+const char *SessionProfile::stageName(SessionStage stage) {
+    switch (stage) {
+        case SessionStage::Generate:
+            return "generate";
+        case SessionStage::SwapCheck:
+            return "swap check";
+        case SessionStage::MatchScan:
+            return "match scan";
+        case SessionStage::Effects:
+            return "effects";
+        case SessionStage::Specials:
+            return "specials";
+        case SessionStage::Clear:
+            return "clear";
+        case SessionStage::Gravity:
+            return "gravity";
+        case SessionStage::Reshuffle:
+            return "reshuffle";
+        default:
+            return "?";
+    }
+}
+
+bool CombatStats::applyMatches(const ElementEffectTable &effects,
+                               const GameBoard::MatchResult &matches) {
+    ElementEffectTable::Values counts;
+    for (int type = 0; type < GameBoard::kGemTypes; ++type) {
+        counts[type] = matches.clearedByType[type].count();
+    }
+    int32_t damage = 0;
+    int32_t heal = 0;
+    int32_t shield = 0;
+    for (int type = 0; type < GameBoard::kGemTypes; ++type) {
+        damage += counts[type] * effects.damage[type];
+        heal += counts[type] * effects.heal[type];
+        shield += counts[type] * effects.shield[type];
+    }
+
+    const CombatStats before = *this;
+    enemyHP = std::max(0, enemyHP - damage);
+    heroHP = std::min(kHeroMaxHP, heroHP + heal);
+    heroShield = std::min(kHeroMaxShield, heroShield + shield);
+    return enemyHP != before.enemyHP || heroHP != before.heroHP ||
+           heroShield != before.heroShield;
+}
+
+GameSession::StageTimer::StageTimer(SessionProfile *profile, SessionStage stage) :
+        profile_(profile),
+        stage_(stage) {
+    if (profile_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+GameSession::StageTimer::~StageTimer() {
+    if (!profile_) {
+        return;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    const int stage = static_cast<int>(stage_);
+    profile_->nanoseconds[stage] += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    ++profile_->calls[stage];
+}
+
+GameSession::GameSession(uint32_t seed, const BalanceConfig &balance) :
+        seed_(seed),
+        balance_(balance),
+        effects_(balance.effects()),
+        rng_(seed) {
+    refillSampler_.setWeights(balance_.refillWeights);
+}
+
+bool GameSession::saveSnapshot(SessionSnapshot &outSnapshot) const {
+    GameBoard::PackedCells packedBoard;
+    GameRefillQueues::Packed packedQueues{};
+    if (state_ == GameState::START || isResolving() || !board_.pack(packedBoard) ||
+        (balance_.prerolledRefills && !refillQueues_.pack(packedQueues))) {
+        return false;
+    }
+
+    SnapshotWriter writer{outSnapshot.bytes.data()};
+    writer.bytes(kSnapshotMagic, sizeof(kSnapshotMagic));
+    writer.u8(kSnapshotVersion);
+    writer.u8(static_cast<uint8_t>(state_));
+    writer.i16(stats_.heroHP);
+    writer.i16(stats_.enemyHP);
+    writer.i16(stats_.heroShield);
+    writer.u32(seed_);
+    writer.u64(rng_.state());
+    writer.u64(rng_.increment());
+    writer.u32(refillBits_.word());
+    writer.u8(static_cast<uint8_t>(refillBits_.bitsLeft()));
+    writer.i16(balance_.fireMatchDamage);
+    writer.i16(balance_.waterMatchHeal);
+    writer.i16(balance_.airMatchDamage);
+    writer.i16(balance_.earthMatchShield);
+    for (const auto weight: balance_.refillWeights) {
+        writer.u16(weight);
+    }
+    writer.u8((balance_.specialRunes ? kRuleSpecialRunes : 0) |
+              (balance_.prerolledRefills ? kRulePrerolledRefills : 0));
+    writer.u8(static_cast<uint8_t>(balance_.heroClass));
+    writer.bytes(packedBoard.data(), packedBoard.size());
+    GameBoard::PackedSpecials packedSpecials;
+    board_.packSpecials(packedSpecials);
+    writer.bytes(packedSpecials.data(), packedSpecials.size());
+    writer.bytes(packedQueues.data(), packedQueues.size());
+    assert(writer.position == SessionSnapshot::kBytes);
+    return true;
+}
+
+bool GameSession::restoreSnapshot(const SessionSnapshot &snapshot) {
+    ByteReader reader(snapshot.bytes.data(), snapshot.bytes.size());
+    uint8_t magic[sizeof(kSnapshotMagic)];
+    reader.bytes(magic, sizeof(magic));
+    if (!std::equal(std::begin(magic), std::end(magic), std::begin(kSnapshotMagic)) ||
+        reader.u8() != kSnapshotVersion) {
+        return false;
+    }
+
+    const uint8_t state = reader.u8();
+    CombatStats stats;
+    stats.heroHP = reader.i16();
+    stats.enemyHP = reader.i16();
+    stats.heroShield = reader.i16();
+    const uint32_t seed = reader.u32();
+    const uint64_t rngState = reader.u64();
+    const uint64_t rngIncrement = reader.u64();
+    const uint32_t refillWord = reader.u32();
+    const uint8_t refillBitsLeft = reader.u8();
+    BalanceConfig balance;
+    balance.fireMatchDamage = reader.i16();
+    balance.waterMatchHeal = reader.i16();
+    balance.airMatchDamage = reader.i16();
+    balance.earthMatchShield = reader.i16();
+    for (auto &weight: balance.refillWeights) {
+        weight = reader.u16();
+    }
+    const uint8_t rules = reader.u8();
+    balance.specialRunes = (rules & kRuleSpecialRunes) != 0;
+    balance.prerolledRefills = (rules & kRulePrerolledRefills) != 0;
+    const uint8_t heroClass = reader.u8();
+    balance.heroClass = static_cast<HeroClass>(heroClass);
+    GameBoard::PackedCells packedBoard;
+    reader.bytes(packedBoard.data(), packedBoard.size());
+    GameBoard::PackedSpecials packedSpecials;
+    reader.bytes(packedSpecials.data(), packedSpecials.size());
+    GameRefillQueues::Packed packedQueues;
+    reader.bytes(packedQueues.data(), packedQueues.size());
+
+    GameBoard board;
+    AliasSampler<GameBoard::kGemTypes> refillSampler;
+    GameRefillQueues refillQueues;
+    if (!reader.ok() || state == static_cast<uint8_t>(GameState::START) ||
+        state > static_cast<uint8_t>(GameState::DEFEAT) || refillBitsLeft > 32 ||
+        (rules & ~(kRuleSpecialRunes | kRulePrerolledRefills)) != 0 ||
+        heroClass >= kHeroClassCount ||
+        !refillSampler.setWeights(balance.refillWeights) ||
+        !board.unpack(packedBoard) || !board.unpackSpecials(packedSpecials) ||
+        (balance.prerolledRefills && !refillQueues.unpack(packedQueues))) {
+        return false;
+    }
+    // snapshots are only taken between turns, when no run is left on the board
+    board.clearDirtyLines();
+
+    seed_ = seed;
+    balance_ = balance;
+    effects_ = balance.effects();
+    board_ = board;
+    rng_.restore(rngState, rngIncrement);
+    refillSampler_ = refillSampler;
+    refillBits_.restore(refillWord, refillBitsLeft);
+    refillQueues_ = refillQueues;
+    stats_ = stats;
+    state_ = static_cast<GameState>(state);
+    lastCascadeLength_ = 0;
+    cascadePhase_ = CascadePhase::Idle;
+    shapes_.count = 0;
+    swappedCells_ = GameBoard::Mask{};
+    notifyBoardReset();
+    notifyStatsChanged();
+    if (combatEvents_) {
+        combatEvents_->pushState(state_);
+    }
+    return true;
+}
+
+void GameSession::start() {
+    refillBits_ = RandomBits{};
+    cascadePhase_ = CascadePhase::Idle;
+    shapes_.count = 0;
+    generateBoard();
+    refillQueues_.clear();
+    topUpRefillQueues();
+
+    stats_ = CombatStats{};
+    lastCascadeLength_ = 0;
+    state_ = GameState::PLAYING;
+    notifyStatsChanged();
+    if (combatEvents_) {
+        combatEvents_->pushState(state_);
+    }
+}
+
+bool GameSession::attemptSwap(int firstIndex, int secondIndex) {
+    if (state_ != GameState::PLAYING || isResolving()) {
+        return false;
+    }
+
+    if (firstIndex < 0 || firstIndex >= GameBoard::kCells ||
+        secondIndex < 0 || secondIndex >= GameBoard::kCells) {
+        return false;
+    }
+
+    const int rowDelta = std::abs(GameBoard::rowOf(firstIndex) - GameBoard::rowOf(secondIndex));
+    const int colDelta =
+            std::abs(GameBoard::columnOf(firstIndex) - GameBoard::columnOf(secondIndex));
+    if (rowDelta + colDelta != 1) {
+        return false;
+    }
+
+    {
+        StageTimer timer(profile_, SessionStage::SwapCheck);
+        if (!board_.isLegalSwap(firstIndex, secondIndex)) {
+            return false;
+        }
+    }
+
+    board_.swapCells(firstIndex, secondIndex);
+    swappedCells_ = GameBoard::Mask::bit(firstIndex) | GameBoard::Mask::bit(secondIndex);
+    if (listener_) {
+        listener_->onGemsSwapped(firstIndex, secondIndex);
+    }
+    if (deltaLog_) {
+        deltaLog_->appendSwap(firstIndex, secondIndex);
+    }
+
+    lastCascadeLength_ = 0;
+    cascadePhase_ = CascadePhase::Scan;
+    if (!stepwiseCascades_) {
+        processMatches();
+    }
+    return true;
+}
+
+bool GameSession::predictSwap(int firstIndex, int secondIndex, SwapOutcome &outOutcome) const {
+    if (state_ != GameState::PLAYING || isResolving()) {
+        return false;
+    }
+    GameSession preview(*this);
+    preview.listener_ = nullptr;
+    preview.profile_ = nullptr;
+    preview.deltaLog_ = nullptr;
+    preview.combatEvents_ = nullptr;
+    preview.stepwiseCascades_ = false;
+    if (!preview.attemptSwap(firstIndex, secondIndex)) {
+        return false;
+    }
+
+    outOutcome.enemyDamage = stats_.enemyHP - preview.stats_.enemyHP;
+    outOutcome.heroHeal = preview.stats_.heroHP - stats_.heroHP;
+    outOutcome.shieldGain = preview.stats_.heroShield - stats_.heroShield;
+    outOutcome.cascadeLength = preview.lastCascadeLength_;
+    outOutcome.stats = preview.stats_;
+    outOutcome.state = preview.state_;
+    return true;
+}
+
+bool GameSession::processMatches() {
+    if (state_ != GameState::PLAYING) {
+        return false;
+    }
+    if (!isResolving()) {
+        lastCascadeLength_ = 0;
+        cascadePhase_ = CascadePhase::Scan;
+    }
+    const int lengthBefore = lastCascadeLength_;
+    while (stepCascade()) {
+    }
+    return lastCascadeLength_ != lengthBefore;
+}
+
+bool GameSession::stepCascade() {
+    switch (cascadePhase_) {
+        case CascadePhase::Idle:
+            return false;
+        case CascadePhase::Scan:
+            scanStep();
+            return true;
+        case CascadePhase::Clear:
+            removeMatches(matchResult_.cleared);
+            formSpecials();
+            cascadePhase_ = CascadePhase::Refill;
+            return true;
+        case CascadePhase::Refill:
+            applyGravityAndFill();
+            ++lastCascadeLength_;
+            // the step that ends the battle still clears and refills, then nothing more resolves
+            cascadePhase_ = state_ == GameState::PLAYING ? CascadePhase::Scan : CascadePhase::Idle;
+            return true;
+    }
+    return false;
+}
+
+int GameSession::advanceCascade(std::chrono::microseconds budget) {
+    const auto deadline = std::chrono::steady_clock::now() + budget;
+    int phases = 0;
+    while (isResolving()) {
+        const bool refill = cascadePhase_ == CascadePhase::Refill;
+        stepCascade();
+        ++phases;
+        if (refill || std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    return phases;
+}
+
+void GameSession::scanStep() {
+    GameBoard::Mask matches;
+    {
+        StageTimer timer(profile_, SessionStage::MatchScan);
+        matches = findMatches();
+        board_.clearDirtyLines();
+    }
+    shapes_.count = 0;
+    if (matches.any() && balance_.specialRunes) {
+        StageTimer timer(profile_, SessionStage::Specials);
+        // runes caught in the matches go off and count as matched
+        matches = board_.resolveSpecials(matches, swappedCells_, shapes_);
+    }
+    swappedCells_ = GameBoard::Mask{};
+    if (matches.none()) {
+        cascadePhase_ = CascadePhase::Idle;
+        if (lastCascadeLength_ > 0 && state_ == GameState::PLAYING) {
+            ensurePlayableBoard();
+        }
+        return;
+    }
+    matchResult_.assign(board_, matches);
+    {
+        StageTimer timer(profile_, SessionStage::Effects);
+        applyMatchEffects(matchResult_);
+    }
+    if (listener_) {
+        listener_->onMatchesResolved(matchResult_);
+    }
+    cascadePhase_ = CascadePhase::Clear;
+}
+
+void GameSession::formSpecials() {
+    for (int i = 0; i < shapes_.count; ++i) {
+        const GameBoard::ShapeMatch &shape = shapes_.shapes[i];
+        board_.setSpecial(shape.cell, shape.special());
+        if (listener_) {
+            listener_->onSpecialRuneFormed(shape.cell, shape.special());
+        }
+        if (deltaLog_) {
+            deltaLog_->appendSpecial(shape.cell, shape.special());
+        }
+    }
+    shapes_.count = 0;
+}
+
+bool GameSession::findHint(GameBoard::Move &outMove) const {
+    if (state_ != GameState::PLAYING || isResolving()) {
+        return false;
+    }
+    return board_.findHint(outMove);
+}
+
+GemType GameSession::nextRefillGem(int column) {
+    if (balance_.prerolledRefills) {
+        return refillQueues_.pop(column);
+    }
+    return static_cast<GemType>(refillSampler_(rng_, refillBits_));
+}
+
+void GameSession::topUpRefillQueues() {
+    if (balance_.prerolledRefills) {
+        refillQueues_.topUp(refillSampler_, rng_, refillBits_);
+    }
+}
+
+GameBoard::Mask GameSession::findMatches() const {
+    const GameBoard::Mask matches = board_.findDirtyMatches();
+#if RUNEBOUND_MATCH_CROSSCHECK
+    assert(matches == board_.findMatches() && "incremental match scan disagrees with a full scan");
+#endif
+    return matches;
+}
+
+void GameSession::generateBoard() {
+    {
+        StageTimer timer(profile_, SessionStage::Generate);
+        board_.generate(rng_, kMinInitialLegalMoves);
+        // the generator only produces match-free layouts
+        board_.clearDirtyLines();
+    }
+    notifyBoardReset();
+}
+
+void GameSession::ensurePlayableBoard() {
+    if (board_.hasLegalMove()) {
+        return;
+    }
+
+    bool reshuffled;
+    {
+        StageTimer timer(profile_, SessionStage::Reshuffle);
+        reshuffled = board_.reshuffle(rng_);
+        // reshuffle only produces match-free layouts
+        board_.clearDirtyLines();
+    }
+    if (!reshuffled) {
+        // no arrangement of the remaining gems is playable, deal a new board instead
+        generateBoard();
+        return;
+    }
+    notifyBoardReset();
+}
+
+void GameSession::applyMatchEffects(const GameBoard::MatchResult &matches) {
+    bool statsChanged = stats_.applyMatches(effects_, matches);
+    if (combatEvents_) {
+        combatEvents_->pushMatches(effects_, matches, stats_);
+    }
+
+    if (state_ == GameState::PLAYING && stats_.outcome() != GameState::PLAYING) {
+        state_ = stats_.outcome();
+        statsChanged = true;
+        if (combatEvents_) {
+            combatEvents_->pushState(state_);
+        }
+    }
+
+    if (statsChanged) {
+        notifyStatsChanged();
+    }
+}
+
+void GameSession::removeMatches(const GameBoard::Mask &cleared) {
+    {
+        StageTimer timer(profile_, SessionStage::Clear);
+        cleared.forEach([this](int index) {
+            board_.set(index, GemType::None);
+        });
+    }
+    if (listener_) {
+        listener_->onGemsCleared(cleared);
+    }
+    if (deltaLog_) {
+        deltaLog_->appendCleared(cleared);
+    }
+}
+
+void GameSession::applyGravityAndFill() {
+    {
+        StageTimer timer(profile_, SessionStage::Gravity);
+        board_.applyGravityAndFill(
+                [this](int column) {
+                    return nextRefillGem(column);
+                },
+                listener_ || deltaLog_ ? &gravity_ : nullptr);
+        topUpRefillQueues();
+    }
+    if (listener_) {
+        listener_->onGemsFell(gravity_);
+    }
+    if (deltaLog_) {
+        deltaLog_->appendGravity(gravity_, board_);
+    }
+}
+
+void GameSession::notifyBoardReset() {
+    if (listener_) {
+        listener_->onBoardReset();
+    }
+    if (deltaLog_) {
+        deltaLog_->appendReset(board_, stats_, state_);
+    }
+}
+
+void GameSession::notifyStatsChanged() {
+    if (listener_) {
+        listener_->onStatsChanged();
+    }
+    if (deltaLog_) {
+        deltaLog_->appendStats(stats_, state_);
+    }
+}
@@ -0,0 +1,403 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GAMESESSION_H
+#define ANDROIDGLINVESTIGATIONS_GAMESESSION_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "BoardEngine.h"
+#include "ElementEffects.h"
+#include "Random.h"
+#include "RefillQueue.h"
+
+class BoardDeltaLog;
+class CombatEventRing;
+
+enum class GameState {
+    START,
+    PLAYING,
+    VICTORY,
+    DEFEAT,
+};
+
+/*!
+ * The tunable numbers behind match effects. Each value is applied once per cleared gem of its
+ * element, scaled by the hero class.
+ */
+struct BalanceConfig {
+    typedef std::array<uint16_t, GameBoard::kGemTypes> RefillWeights;
+
+    int fireMatchDamage = 10;
+    int waterMatchHeal = 6;
+    int airMatchDamage = 4;
+    int earthMatchShield = 12;
+    //! relative odds of each gem type, in GemType order, when cleared cells refill
+    RefillWeights refillWeights = equalWeights();
+    //! matches of four, five or crossing runs leave a special rune behind
+    bool specialRunes = true;
+    //! refills come from per-column queues rolled ahead of time rather than drawn on demand
+    bool prerolledRefills = true;
+    //! the hero the player picked; see @a kHeroElementScales
+    HeroClass heroClass = HeroClass::Warrior;
+
+    //! what one cleared gem of each element does for this hero
+    constexpr ElementEffectTable effects() const {
+        return makeElementEffects({fireMatchDamage, waterMatchHeal, airMatchDamage,
+                                   earthMatchShield}, heroClass);
+    }
+
+    static constexpr RefillWeights equalWeights() {
+        RefillWeights weights{};
+        for (auto &weight: weights) {
+            weight = 1;
+        }
+        return weights;
+    }
+};
+
+static_assert(BalanceConfig{}.effects().damage[static_cast<int>(GemType::Fire)] ==
+              BalanceConfig{}.fireMatchDamage &&
+              BalanceConfig{}.effects().heal[static_cast<int>(GemType::Water)] ==
+              BalanceConfig{}.waterMatchHeal &&
+              BalanceConfig{}.effects().damage[static_cast<int>(GemType::Air)] ==
+              BalanceConfig{}.airMatchDamage &&
+              BalanceConfig{}.effects().shield[static_cast<int>(GemType::Earth)] ==
+              BalanceConfig{}.earthMatchShield,
+              "the warrior plays the base values unchanged");
+
+/*!
+ * Hit points and shield of both combatants.
+ */
+struct CombatStats {
+    static constexpr int kHeroMaxHP = 100;
+    static constexpr int kEnemyMaxHP = 100;
+    static constexpr int kHeroMaxShield = 100;
+
+    int heroHP = kHeroMaxHP;
+    int enemyHP = kEnemyMaxHP;
+    int heroShield = 0;
+
+    /*!
+     * Applies the effects of one cascade step: the cleared gems of every element are counted,
+     * weighed against @a effects and the totals clamped once.
+     * @return true if any value changed
+     */
+    bool applyMatches(const ElementEffectTable &effects, const GameBoard::MatchResult &matches);
+
+    /*!
+     * @return VICTORY or DEFEAT once one side is down, PLAYING otherwise
+     */
+    inline GameState outcome() const {
+        if (enemyHP <= 0) {
+            return GameState::VICTORY;
+        }
+        if (heroHP <= 0) {
+            return GameState::DEFEAT;
+        }
+        return GameState::PLAYING;
+    }
+};
+
+/*!
+ * What a swap leads to once its whole cascade has resolved, as worked out by
+ * @a GameSession::predictSwap before the swap is made.
+ */
+struct SwapOutcome {
+    //! hit points the enemy loses
+    int enemyDamage = 0;
+    //! hit points the hero regains
+    int heroHeal = 0;
+    //! shield the hero gains
+    int shieldGain = 0;
+    int cascadeLength = 0;
+    //! both combatants once the cascade has resolved
+    CombatStats stats;
+    GameState state = GameState::PLAYING;
+};
+
+/*!
+ * The phases of a turn that @a SessionProfile keeps timings for.
+ */
+enum class SessionStage {
+    Generate,
+    SwapCheck,
+    MatchScan,
+    Effects,
+    Specials,
+    Clear,
+    Gravity,
+    Reshuffle,
+    Count,
+};
+
+static constexpr int kSessionStageCount = static_cast<int>(SessionStage::Count);
+
+/*!
+ * Accumulated wall time and call counts per stage. Attach one with @a GameSession::setProfile to
+ * find out where a session spends its time; with none attached nothing is measured.
+ */
+struct SessionProfile {
+    std::array<uint64_t, kSessionStageCount> nanoseconds{};
+    std::array<uint64_t, kSessionStageCount> calls{};
+
+    static const char *stageName(SessionStage stage);
+};
+
+/*!
+ * The logical state of a @a GameSession in a fixed number of bytes: the board at two bits per
+ * gem and three per special rune, the refill queues, the combat stats, the game state, the balance
+ * values, the hero class and the random generator, so a restored session continues exactly as the
+ * saved one would have.
+ */
+struct SessionSnapshot {
+    static constexpr size_t kBytes = 4 + 1 + 1 + 3 * 2 + 4 + 2 * 8 + 4 + 1 + 4 * 2 +
+                                     GameBoard::kGemTypes * 2 + 1 + GameBoard::kPackedBytes +
+                                     GameBoard::kPackedSpecialBytes +
+                                     GameRefillQueues::kPackedBytes + 1;
+
+    std::array<uint8_t, kBytes> bytes{};
+};
+
+/*!
+ * Where a cascade stands between two calls to @a GameSession::stepCascade.
+ */
+enum class CascadePhase {
+    //! the board is settled and waiting for a swap
+    Idle,
+    //! the next step looks for runs and applies their effects
+    Scan,
+    //! the next step removes the runs just scored
+    Clear,
+    //! the next step drops the remaining gems and refills the gaps
+    Refill,
+};
+
+/*!
+ * Receives every change a @a GameSession makes so a presentation layer can mirror it. All methods
+ * default to doing nothing.
+ */
+class GameSessionListener {
+public:
+    virtual ~GameSessionListener() = default;
+
+    //! the whole board was replaced (new game, reshuffle)
+    virtual void onBoardReset() {}
+
+    //! the gems in two adjacent cells traded places
+    virtual void onGemsSwapped(int /*firstIndex*/, int /*secondIndex*/) {}
+
+    //! a cascade step matched @a matches; called after its effects were applied, before removal
+    virtual void onMatchesResolved(const GameBoard::MatchResult & /*matches*/) {}
+
+    //! the matched cells were emptied
+    virtual void onGemsCleared(const GameBoard::Mask & /*cells*/) {}
+
+    //! the gem at @a index became @a special; called after the rest of its group was cleared
+    virtual void onSpecialRuneFormed(int /*index*/, SpecialRune /*special*/) {}
+
+    /*!
+     * The remaining gems fell into the cleared cells and new ones filled the gaps at the top;
+     * @a gravity says how far each of them dropped.
+     */
+    virtual void onGemsFell(const GameBoard::Gravity & /*gravity*/) {}
+
+    //! hit points, shield or game state changed
+    virtual void onStatsChanged() {}
+};
+
+/*!
+ * One battle: the board, both combatants and the random source, with no rendering or platform
+ * dependencies. The Android renderer drives one of these from touch input; host tools drive them
+ * directly to simulate and profile games.
+ */
+class GameSession {
+public:
+    static constexpr int kHeroMaxHP = CombatStats::kHeroMaxHP;
+    static constexpr int kEnemyMaxHP = CombatStats::kEnemyMaxHP;
+    static constexpr int kHeroMaxShield = CombatStats::kHeroMaxShield;
+    //! a dealt board always offers at least this many legal swaps
+    static constexpr int kMinInitialLegalMoves = 3;
+
+    /*!
+     * @param seed seeds every random decision the session makes, so equal seeds and equal input
+     *     give equal games
+     * @param balance the match effect values to play with
+     */
+    explicit GameSession(uint32_t seed, const BalanceConfig &balance = BalanceConfig{});
+
+    void setListener(GameSessionListener *listener) { listener_ = listener; }
+
+    void setProfile(SessionProfile *profile) { profile_ = profile; }
+
+    /*!
+     * Appends every change from now on to @a log as well, next to the listener calls. With none
+     * attached, the default, nothing is recorded.
+     */
+    void setDeltaLog(BoardDeltaLog *log) { deltaLog_ = log; }
+
+    /*!
+     * Pushes every damage, heal, shield, effect spawn and state change from now on to @a events.
+     * With none attached, the default, no events are made.
+     */
+    void setCombatEvents(CombatEventRing *events) { combatEvents_ = events; }
+
+    /*!
+     * Deals a fresh board and resets both combatants. The session is PLAYING afterwards.
+     */
+    void start();
+
+    /*!
+     * Captures the session between turns.
+     * @return false if the session has not started or a cascade is unresolved
+     */
+    bool saveSnapshot(SessionSnapshot &outSnapshot) const;
+
+    /*!
+     * Continues from @a snapshot instead of dealing a new board. The listener sees a board reset
+     * and a stats change, as after @a start.
+     * @return false, leaving the session untouched, if @a snapshot does not hold a valid state
+     */
+    bool restoreSnapshot(const SessionSnapshot &snapshot);
+
+    /*!
+     * With stepwise cascades a swap only starts its cascade, and the caller resolves it with
+     * @a stepCascade or @a advanceCascade, so every intermediate board can be shown. Otherwise,
+     * the default, @a attemptSwap resolves the whole cascade before returning.
+     */
+    inline void setStepwiseCascades(bool stepwise) { stepwiseCascades_ = stepwise; }
+
+    /*!
+     * Swaps two adjacent cells if that completes a run and resolves the resulting cascade, or
+     * just starts it if cascades are stepwise. Swaps are refused while a cascade is unresolved.
+     * @return true if the swap was legal and applied
+     */
+    bool attemptSwap(int firstIndex, int secondIndex);
+
+    /*!
+     * Works out what @a attemptSwap(@a firstIndex, @a secondIndex) would lead to by resolving it
+     * on a copy of the session; the session itself, its listener and its delta log see nothing.
+     * Refills come from the same random stream the real swap will use, so the prediction is
+     * exact.
+     * @return false if the swap would be refused
+     */
+    bool predictSwap(int firstIndex, int secondIndex, SwapOutcome &outOutcome) const;
+
+    /*!
+     * Resolves pending matches until the board settles or the battle ends, then reshuffles a
+     * settled board that has no legal swap left.
+     * @return true if anything on the board changed
+     */
+    bool processMatches();
+
+    /*!
+     * Runs the next phase of the cascade in progress: a scan and its effects, a clear or a
+     * refill. The scan that finds nothing left settles the cascade and reshuffles the board if
+     * it has no legal swap.
+     * @return false if there was no cascade to advance
+     */
+    bool stepCascade();
+
+    /*!
+     * Runs cascade phases until the board settles, a refill lands or @a budget is spent, always
+     * running at least one. Stopping after each refill gives the caller a chance to show the
+     * dropped gems before the next scan; the budget keeps a frame's share of a long cascade
+     * bounded by the cost of a single phase.
+     * @return the number of phases run
+     */
+    int advanceCascade(std::chrono::microseconds budget);
+
+    inline CascadePhase cascadePhase() const { return cascadePhase_; }
+
+    //! true while a swap's cascade is unresolved; the board may have holes
+    inline bool isResolving() const { return cascadePhase_ != CascadePhase::Idle; }
+
+    /*!
+     * @return false if the battle is not in progress, a cascade is unresolved or the board has
+     * no legal swap
+     */
+    bool findHint(GameBoard::Move &outMove) const;
+
+    inline const GameBoard &board() const { return board_; }
+
+    //! the gems the next refills drop into each column; empty unless refills are pre-rolled
+    inline const GameRefillQueues &refillQueues() const { return refillQueues_; }
+
+    inline const BalanceConfig &balance() const { return balance_; }
+
+    inline const ElementEffectTable &effects() const { return effects_; }
+
+    inline uint32_t seed() const { return seed_; }
+
+    inline GameState state() const { return state_; }
+
+    inline bool isStarted() const { return state_ != GameState::START; }
+
+    inline const CombatStats &stats() const { return stats_; }
+
+    inline int heroHP() const { return stats_.heroHP; }
+
+    inline int enemyHP() const { return stats_.enemyHP; }
+
+    inline int heroShield() const { return stats_.heroShield; }
+
+    //! number of cascade steps resolved by the last or current cascade
+    inline int lastCascadeLength() const { return lastCascadeLength_; }
+
+private:
+    /*!
+     * Times one stage into the attached profile, if any.
+     */
+    class StageTimer {
+    public:
+        StageTimer(SessionProfile *profile, SessionStage stage);
+        ~StageTimer();
+
+    private:
+        SessionProfile *profile_;
+        SessionStage stage_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    GemType nextRefillGem(int column);
+    void topUpRefillQueues();
+    GameBoard::Mask findMatches() const;
+    void generateBoard();
+    void ensurePlayableBoard();
+    void scanStep();
+    void formSpecials();
+    void applyMatchEffects(const GameBoard::MatchResult &matches);
+    void removeMatches(const GameBoard::Mask &cleared);
+    void applyGravityAndFill();
+    void notifyBoardReset();
+    void notifyStatsChanged();
+
+    uint32_t seed_;
+    BalanceConfig balance_;
+    //! built from balance_ whenever it changes
+    ElementEffectTable effects_;
+    GameBoard board_;
+    GameBoard::MatchResult matchResult_;
+    //! the groups of the current scan that leave a special rune behind
+    GameBoard::ShapeList shapes_;
+    //! the two cells of the swap that started the cascade, until its first scan
+    GameBoard::Mask swappedCells_;
+    //! only filled in for the listener and the delta log
+    GameBoard::Gravity gravity_;
+    Pcg32 rng_;
+    //! refills draw a few bits at a time from rng_ through the balance's weights
+    AliasSampler<GameBoard::kGemTypes> refillSampler_;
+    RandomBits refillBits_;
+    //! fed from refillSampler_ after every refill when the balance pre-rolls refills
+    GameRefillQueues refillQueues_;
+    CombatStats stats_;
+    int lastCascadeLength_ = 0;
+    CascadePhase cascadePhase_ = CascadePhase::Idle;
+    bool stepwiseCascades_ = false;
+    GameState state_ = GameState::START;
+    GameSessionListener *listener_ = nullptr;
+    SessionProfile *profile_ = nullptr;
+    BoardDeltaLog *deltaLog_ = nullptr;
+    CombatEventRing *combatEvents_ = nullptr;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_GAMESESSION_H
@@ -0,0 +1,244 @@
+#include "MoveSearch.h"
+
+#include <algorithm>
+#include <limits>
+
+//! weight of a reward one swap further in the future
+static constexpr float kDiscount = 0.9f;
+static constexpr float kVictoryReward = 1000.0f;
+static constexpr float kHealWeight = 0.5f;
+static constexpr float kShieldWeight = 0.25f;
+
+static inline uint64_t splitMix64(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+MoveSearch::MoveSearch(int threadCount, size_t tableEntries) :
+        pool_(threadCount),
+        table_(tableEntries),
+        workers_(static_cast<size_t>(pool_.threadCount())) {
+    // fixed seed so a position hashes the same in every run
+    uint64_t seed = 0x52756E65626F756EULL;
+    for (auto &cell: cellKeys_) {
+        for (auto &key: cell) {
+            key = splitMix64(seed);
+        }
+    }
+    for (auto &cell: specialKeys_) {
+        for (auto &key: cell) {
+            key = splitMix64(seed);
+        }
+    }
+}
+
+SearchResult MoveSearch::search(const GameSession &session, const SearchLimits &limits) {
+    const auto start = std::chrono::steady_clock::now();
+    deadline_ = start + limits.timeBudget;
+    aborted_.store(false, std::memory_order_relaxed);
+    balance_ = session.balance();
+    effects_ = session.effects();
+    refillSampler_ = AliasSampler<GameBoard::kGemTypes>{};
+    refillSampler_.setWeights(balance_.refillWeights);
+    chanceSamples_ = std::max(1, limits.chanceSamples);
+    table_.newSearch();
+    for (auto &worker: workers_) {
+        worker.nodes = 0;
+    }
+
+    SearchResult result;
+    if (session.state() != GameState::PLAYING) {
+        return result;
+    }
+
+    root_.board = session.board();
+    root_.stats = session.stats();
+    const int moveCount = root_.board.findLegalMoves(rootMoves_);
+    if (moveCount == 0) {
+        return result;
+    }
+    result.found = true;
+    result.move = rootMoves_.moves[0];
+
+    rootKey_ = hashPosition(root_);
+    for (int depth = 1; depth <= limits.maxDepth; ++depth) {
+        rootDepth_ = depth;
+        // the job only captures what fits in std::function's inline storage, so a search does
+        // not allocate
+        pool_.parallelFor(moveCount, [this, depth](int index, int thread) {
+            rootValues_[index] =
+                    chanceNode(root_, rootKey_, rootMoves_.moves[index], depth, workers_[thread]);
+        });
+        if (aborted_.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        const auto best = std::max_element(rootValues_.begin(), rootValues_.begin() + moveCount);
+        result.move = rootMoves_.moves[best - rootValues_.begin()];
+        result.value = *best;
+        result.completedDepth = depth;
+    }
+
+    for (const auto &worker: workers_) {
+        result.nodes += worker.nodes;
+    }
+    result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    return result;
+}
+
+float MoveSearch::maxNode(const Position &position, int depth, Worker &worker) {
+    if (depth <= 0 || position.stats.outcome() != GameState::PLAYING) {
+        return 0.0f;
+    }
+    ++worker.nodes;
+
+    const uint64_t key = hashPosition(position);
+    float value;
+    if (table_.probe(key, depth, value)) {
+        return value;
+    }
+
+    GameBoard::MoveList moves;
+    const int moveCount = position.board.findLegalMoves(moves);
+    // a settled board without swaps gets reshuffled, which scores nothing by itself
+    value = moveCount > 0 ? -std::numeric_limits<float>::infinity() : 0.0f;
+    for (int i = 0; i < moveCount; ++i) {
+        value = std::max(value, chanceNode(position, key, moves.moves[i], depth, worker));
+        if (aborted_.load(std::memory_order_relaxed)) {
+            return 0.0f;
+        }
+    }
+
+    table_.store(key, depth, value);
+    return value;
+}
+
+float MoveSearch::chanceNode(const Position &position,
+                             uint64_t key,
+                             const GameBoard::Move &move,
+                             int depth,
+                             Worker &worker) {
+    const uint64_t moveKey = key ^ ((uint64_t{move.from} << 8 | move.to) * 0xD1B54A32D192ED03ULL);
+    // only the swaps at the root average several refills; deeper chance nodes follow a single
+    // sampled refill, which keeps the branching factor at the number of legal swaps
+    const int samples = depth == rootDepth_ ? chanceSamples_ : 1;
+    float total = 0.0f;
+    for (int sample = 0; sample < samples; ++sample) {
+        if (outOfTime()) {
+            return 0.0f;
+        }
+        Position child = position;
+        child.board.swapCells(move.from, move.to);
+        // refills are drawn from the position, the swap and the sample number alone, so every
+        // thread that reaches this node sees the same outcomes and cached values stay consistent
+        uint64_t refillRng = moveKey + static_cast<uint64_t>(sample);
+        const auto draw = [&refillRng]() {
+            return static_cast<uint32_t>(splitMix64(refillRng) >> 32);
+        };
+        RandomBits bits;
+        float reward = resolveCascade(child, move, worker, [this, &draw, &bits](int) {
+            return static_cast<GemType>(refillSampler_(draw, bits));
+        });
+        reward += kDiscount * maxNode(child, depth - 1, worker);
+        total += reward;
+    }
+    return total / static_cast<float>(samples);
+}
+
+template<typename NextGem>
+float MoveSearch::resolveCascade(Position &position,
+                                 const GameBoard::Move &move,
+                                 Worker &worker,
+                                 NextGem &&nextGem) const {
+    GameBoard &board = position.board;
+    CombatStats &stats = position.stats;
+    // a rune formed by the swap's own match goes where the swap put a gem, as in the session
+    GameBoard::Mask swapped = GameBoard::Mask::bit(move.from) | GameBoard::Mask::bit(move.to);
+    float reward = 0.0f;
+    for (;;) {
+        GameBoard::Mask matches = board.findDirtyMatches();
+        board.clearDirtyLines();
+        worker.shapes.count = 0;
+        if (matches.any() && balance_.specialRunes) {
+            matches = board.resolveSpecials(matches, swapped, worker.shapes);
+        }
+        swapped = GameBoard::Mask{};
+        if (matches.none()) {
+            break;
+        }
+
+        worker.matches.assign(board, matches);
+        const CombatStats before = stats;
+        stats.applyMatches(effects_, worker.matches);
+        reward += static_cast<float>(before.enemyHP - stats.enemyHP) +
+                  kHealWeight * static_cast<float>(stats.heroHP - before.heroHP) +
+                  kShieldWeight * static_cast<float>(stats.heroShield - before.heroShield);
+        if (stats.outcome() != GameState::PLAYING) {
+            if (stats.outcome() == GameState::VICTORY) {
+                reward += kVictoryReward;
+            }
+            break;
+        }
+
+        matches.forEach([&board](int index) {
+            board.set(index, GemType::None);
+        });
+        for (int i = 0; i < worker.shapes.count; ++i) {
+            board.setSpecial(worker.shapes.shapes[i].cell, worker.shapes.shapes[i].special());
+        }
+        board.applyGravityAndFill(nextGem);
+    }
+    return reward;
+}
+
+float MoveSearch::replaySwap(const GameSession &session,
+                             const GameBoard::Move &move,
+                             const RefillScript &refills,
+                             GameBoard &outBoard,
+                             CombatStats &outStats) {
+    balance_ = session.balance();
+    effects_ = session.effects();
+    Position position{session.board(), session.stats()};
+    position.board.swapCells(move.from, move.to);
+    std::array<int, GameBoard::kColumns> drawn{};
+    const auto nextGem = [&refills, &drawn](int column) {
+        // a cascade that runs past the script gets gems no session would have drawn
+        const int next = drawn[column]++;
+        return next < refills.counts[column] ? refills.gems[column][next] : GemType::Fire;
+    };
+    const float reward = resolveCascade(position, move, workers_[0], nextGem);
+    outBoard = position.board;
+    outStats = position.stats;
+    return reward;
+}
+
+uint64_t MoveSearch::hashPosition(const Position &position) const {
+    uint64_t key = 0;
+    for (int cell = 0; cell < GameBoard::kCells; ++cell) {
+        const GemType type = position.board.at(cell);
+        if (type != GemType::None) {
+            key ^= cellKeys_[cell][static_cast<int>(type)];
+        }
+    }
+    position.board.specialCells().forEach([&key, &position, this](int cell) {
+        key ^= specialKeys_[cell][static_cast<int>(position.board.special(cell))];
+    });
+    uint64_t statsKey = static_cast<uint64_t>(position.stats.enemyHP) |
+                        static_cast<uint64_t>(position.stats.heroHP) << 16 |
+                        static_cast<uint64_t>(position.stats.heroShield) << 32;
+    return key ^ splitMix64(statsKey);
+}
+
+bool MoveSearch::outOfTime() {
+    if (aborted_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if (std::chrono::steady_clock::now() >= deadline_) {
+        aborted_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
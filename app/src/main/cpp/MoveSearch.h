@@ -0,0 +1,154 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MOVESEARCH_H
+#define ANDROIDGLINVESTIGATIONS_MOVESEARCH_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "GameSession.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
+
+/*!
+ * How far and how long @a MoveSearch may look ahead.
+ */
+struct SearchLimits {
+    //! iterative deepening stops after this many swaps
+    int maxDepth = 6;
+    //! wall time after which the search is abandoned and the deepest finished answer returned
+    std::chrono::microseconds timeBudget{2000};
+    //! refills sampled for every swap at the root; deeper swaps follow one sampled refill
+    int chanceSamples = 3;
+};
+
+struct SearchResult {
+    GameBoard::Move move;
+    //! false if the board had no legal swap
+    bool found = false;
+    //! deepest iteration that finished inside the budget; 0 if only the fallback move is known
+    int completedDepth = 0;
+    //! expected discounted reward of @a move at @a completedDepth
+    float value = 0.0f;
+    uint64_t nodes = 0;
+    std::chrono::microseconds elapsed{0};
+};
+
+/*!
+ * The gems each column draws over one cascade, in the order it draws them, for replaying a swap
+ * with refills known in advance.
+ */
+struct RefillScript {
+    static constexpr int kDepth = 64;
+
+    std::array<std::array<GemType, kDepth>, GameBoard::kColumns> gems{};
+    std::array<int, GameBoard::kColumns> counts{};
+    //! a column drew more than @a kDepth gems; the rest were not kept
+    bool overflowed = false;
+
+    inline void clear() {
+        counts.fill(0);
+        overflowed = false;
+    }
+
+    inline void push(int column, GemType gem) {
+        if (counts[column] == kDepth) {
+            overflowed = true;
+            return;
+        }
+        gems[column][counts[column]++] = gem;
+    }
+};
+
+/*!
+ * Expectimax search over swaps. A swap is a max node; the cascade it sets off is resolved with the
+ * same rules as @a GameSession::processMatches, special runes included when the balance turns
+ * them on, and the gems that fall in from the top are a chance node, approximated by averaging
+ * sampled refills. The reward of a swap is the damage it deals plus a little for healing and
+ * shield, with a bonus for winning.
+ *
+ * Root swaps are spread over a thread pool, positions are cached by Zobrist hash in a shared
+ * lock-free transposition table, and the search deepens one swap at a time until the time budget
+ * runs out, so a call never overruns its budget by more than one node.
+ */
+class MoveSearch {
+public:
+    /*!
+     * @param threadCount threads to search with, 0 for one per hardware thread
+     * @param tableEntries transposition table size, rounded down to a power of two
+     */
+    explicit MoveSearch(int threadCount = 0, size_t tableEntries = size_t{1} << 16);
+
+    /*!
+     * Picks the swap with the best expected reward for the session's current position.
+     */
+    SearchResult search(const GameSession &session, const SearchLimits &limits);
+
+    /*!
+     * Plays @a move on @a session's position by the search's own rules, but with the gems that
+     * fall in taken from @a refills rather than sampled, so a caller that knows what the session
+     * drew can check that the search foresees the position the session reaches. Must not overlap
+     * a search.
+     * @param outBoard the board once the cascade settles, or as it stood when the battle ended
+     * @return the reward the search credits the swap with
+     */
+    float replaySwap(const GameSession &session,
+                     const GameBoard::Move &move,
+                     const RefillScript &refills,
+                     GameBoard &outBoard,
+                     CombatStats &outStats);
+
+    inline int threadCount() const { return pool_.threadCount(); }
+
+private:
+    struct Position {
+        GameBoard board;
+        CombatStats stats;
+    };
+
+    //! per-thread scratch space, padded so threads never share a cache line
+    struct alignas(64) Worker {
+        GameBoard::MatchResult matches;
+        GameBoard::ShapeList shapes;
+        uint64_t nodes = 0;
+    };
+
+    float maxNode(const Position &position, int depth, Worker &worker);
+    float chanceNode(const Position &position,
+                     uint64_t key,
+                     const GameBoard::Move &move,
+                     int depth,
+                     Worker &worker);
+    /*!
+     * @param nextGem called as nextGem(column) -> GemType for every refilled cell, in the order
+     *     of @a GameBoard::applyGravityAndFill
+     */
+    template<typename NextGem>
+    float resolveCascade(Position &position,
+                         const GameBoard::Move &move,
+                         Worker &worker,
+                         NextGem &&nextGem) const;
+    uint64_t hashPosition(const Position &position) const;
+    bool outOfTime();
+
+    ThreadPool pool_;
+    TranspositionTable table_;
+    std::array<std::array<uint64_t, GameBoard::kGemTypes>, GameBoard::kCells> cellKeys_;
+    //! index 0, no rune, is never hashed
+    std::array<std::array<uint64_t, kSpecialRuneKinds>, GameBoard::kCells> specialKeys_;
+    std::vector<Worker> workers_;
+    Position root_;
+    uint64_t rootKey_ = 0;
+    GameBoard::MoveList rootMoves_;
+    std::array<float, GameBoard::kMaxMoves> rootValues_{};
+    BalanceConfig balance_;
+    ElementEffectTable effects_;
+    AliasSampler<GameBoard::kGemTypes> refillSampler_;
+    int chanceSamples_ = 1;
+    int rootDepth_ = 0;
+    std::chrono::steady_clock::time_point deadline_;
+    std::atomic<bool> aborted_{false};
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_MOVESEARCH_H
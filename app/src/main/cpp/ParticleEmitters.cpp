@@ -0,0 +1,74 @@
+#include "ParticleEmitters.h"
+
+#include <algorithm>
+
+namespace {
+
+inline float draw(const FloatRange &range, Pcg32 &rng) {
+    return rng.uniform(range.min, range.max);
+}
+
+} // namespace
+
+bool ParticleEmitters::trigger(ElementSpawn spawn,
+                               float centerX,
+                               float centerY,
+                               int gems,
+                               float cellSize) {
+    if (spawn == ElementSpawn::None || gems <= 0 || cellSize <= 0.0f) {
+        return true;
+    }
+    const EmitterDescriptor &descriptor = kElementEmitters[static_cast<int>(spawn)];
+    const Emitter emitter{spawn, gems, centerX, centerY, cellSize, descriptor.duration,
+                          descriptor.burstPerGem * static_cast<float>(gems)};
+    if (emitters_.add(emitter) < 0) {
+        dropped_ += static_cast<uint64_t>(emitter.owed);
+        return false;
+    }
+    return true;
+}
+
+int ParticleEmitters::update(float deltaTimeSeconds, ParticlePool &pool, Pcg32 &rng) {
+    int spawned = 0;
+    emitters_.forEach([&](Emitter &emitter) {
+        const EmitterDescriptor &descriptor = kElementEmitters[static_cast<int>(emitter.spawn)];
+        const float trickle = std::max(0.0f, std::min(deltaTimeSeconds, emitter.remaining));
+        emitter.owed += descriptor.ratePerGem * static_cast<float>(emitter.gems) * trickle;
+        emitter.remaining -= deltaTimeSeconds;
+
+        const int due = static_cast<int>(emitter.owed);
+        emitter.owed -= static_cast<float>(due);
+        for (int i = 0; i < due; ++i) {
+            if (spawned == kSpawnBudget || !pool.spawn(makeParticle(emitter, rng))) {
+                dropped_ += static_cast<uint64_t>(due - i);
+                break;
+            }
+            ++spawned;
+        }
+    });
+    emitters_.removeIf([](const Emitter &emitter) {
+        return emitter.remaining <= 0.0f;
+    });
+    return spawned;
+}
+
+ParticlePool::Spawn ParticleEmitters::makeParticle(const Emitter &emitter, Pcg32 &rng) {
+    const EmitterDescriptor &descriptor = kElementEmitters[static_cast<int>(emitter.spawn)];
+    const float cell = emitter.cellSize;
+    ParticlePool::Spawn particle{};
+    particle.centerX = emitter.centerX;
+    particle.centerY = emitter.centerY;
+    particle.velocityX = draw(descriptor.velocityX, rng) * cell;
+    particle.velocityY = draw(descriptor.velocityY, rng) * cell;
+    particle.radius = draw(descriptor.radius, rng) * cell;
+    particle.radiusGrowth = draw(descriptor.radiusGrowth, rng) * cell;
+    particle.angle = rng.uniform(0.0f, kParticleTwoPi);
+    particle.angularVelocity = draw(descriptor.angularVelocity, rng);
+    particle.maxLife = draw(descriptor.life, rng);
+    particle.baseSize = draw(descriptor.size, rng) * cell;
+    particle.endScale = descriptor.endScale;
+    particle.pulseFrequency = draw(descriptor.pulseFrequency, rng);
+    particle.pulseAmount = descriptor.pulseAmount;
+    particle.layer = static_cast<uint8_t>(emitter.spawn);
+    return particle;
+}
@@ -0,0 +1,133 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PARTICLEEMITTERS_H
+#define ANDROIDGLINVESTIGATIONS_PARTICLEEMITTERS_H
+
+#include <array>
+#include <cstdint>
+
+#include "Archetype.h"
+#include "ElementEffects.h"
+#include "ParticlePool.h"
+#include "Random.h"
+
+/*!
+ * A value drawn uniformly between @a min and @a max for every particle.
+ */
+struct FloatRange {
+    float min;
+    float max;
+};
+
+/*!
+ * How the particles of one kind of element effect look and behave: a burst when the match
+ * clears, then a steady trickle for a while. Lengths are in board cells, so effects keep their
+ * look as the screen resizes; times are in seconds. Counts scale with the gems matched.
+ */
+struct EmitterDescriptor {
+    //! texture asset the particles are drawn with, or nullptr for @a fallbackColor alone
+    const char *assetPath;
+    //! red, green, blue and alpha of a plain texture used when the asset is missing
+    std::array<uint8_t, 4> fallbackColor;
+
+    //! particles spawned at once per matched gem
+    float burstPerGem;
+    //! particles spawned per second per matched gem after the burst, for @a duration seconds
+    float ratePerGem;
+    float duration;
+
+    FloatRange life;
+    //! how far from the centre of the match a particle starts out, and how fast that grows
+    FloatRange radius;
+    FloatRange radiusGrowth;
+    //! radians per second it circles the centre
+    FloatRange angularVelocity;
+    //! how fast the point it circles drifts; positive y is up
+    FloatRange velocityX;
+    FloatRange velocityY;
+    FloatRange size;
+    //! size at the end of its life as a fraction of its size at birth
+    float endScale;
+    FloatRange pulseFrequency;
+    float pulseAmount;
+};
+
+/*!
+ * Every element effect's particles, indexed by ElementSpawn; None spawns nothing.
+ */
+static constexpr std::array<EmitterDescriptor, kElementSpawnCount> kElementEmitters = {{
+        // None
+        {nullptr, {0, 0, 0, 0}, 0.0f, 0.0f, 0.0f,
+         {0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f},
+         {0.0f, 0.0f}, 1.0f, {0.0f, 0.0f}, 0.0f},
+        // WindSwirl: rings circling the match and fading where they are
+        {"puzzle/circle.png", {200, 255, 255, 180}, 2.0f, 0.0f, 0.0f,
+         {0.8f, 1.4f}, {0.2f, 0.55f}, {-0.05f, 0.08f}, {3.0f, 6.0f}, {0.0f, 0.0f}, {0.0f, 0.0f},
+         {0.4f, 0.7f}, 0.7f, {0.8f, 1.2f}, 0.1f},
+        // Embers: sparks flickering upwards for a moment after the match
+        {nullptr, {255, 140, 40, 220}, 2.0f, 12.0f, 0.4f,
+         {0.5f, 0.9f}, {0.0f, 0.3f}, {0.0f, 0.1f}, {-2.0f, 2.0f}, {-0.3f, 0.3f}, {0.8f, 1.6f},
+         {0.12f, 0.25f}, 0.2f, {3.0f, 5.0f}, 0.2f},
+        // Droplets: a splash that spreads and falls
+        {nullptr, {80, 160, 255, 200}, 4.0f, 0.0f, 0.0f,
+         {0.6f, 1.0f}, {0.0f, 0.2f}, {0.3f, 0.6f}, {-1.0f, 1.0f}, {-0.6f, 0.6f}, {-1.5f, -0.5f},
+         {0.12f, 0.22f}, 0.5f, {0.0f, 0.0f}, 0.0f},
+        // Shards: chips of stone bursting outwards
+        {nullptr, {150, 110, 60, 230}, 3.0f, 0.0f, 0.0f,
+         {0.4f, 0.7f}, {0.1f, 0.3f}, {1.0f, 2.0f}, {-1.0f, 1.0f}, {0.0f, 0.0f}, {-0.3f, 0.0f},
+         {0.15f, 0.3f}, 0.6f, {0.0f, 0.0f}, 0.0f},
+}};
+
+/*!
+ * The element effects under way, spawning into a shared @a ParticlePool from the descriptors in
+ * @a kElementEmitters. No more than @a kSpawnBudget particles are spawned per update, however
+ * many effects run: under load, spawns are dropped rather than frames, and what is dropped is
+ * never made up later, so effects end on time.
+ */
+class ParticleEmitters {
+public:
+    static constexpr int kMaxEmitters = 32;
+    static constexpr int kSpawnBudget = 256;
+
+    /*!
+     * Starts the effect @a spawn for @a gems matched gems around (@a centerX, @a centerY), on a
+     * board whose cells are @a cellSize across. Its burst goes out with the next update.
+     * @return false if too many effects are running; this one is dropped
+     */
+    bool trigger(ElementSpawn spawn, float centerX, float centerY, int gems, float cellSize);
+
+    /*!
+     * Spawns into @a pool what every effect owes for the last @a deltaTimeSeconds, within the
+     * budget, and retires the effects that are done.
+     * @return the number of particles spawned
+     */
+    int update(float deltaTimeSeconds, ParticlePool &pool, Pcg32 &rng);
+
+    inline int active() const { return emitters_.size(); }
+
+    //! particles and effects given up for the budget, a full pool or too many effects
+    inline uint64_t dropped() const { return dropped_; }
+
+    inline void clear() { emitters_.clear(); }
+
+private:
+    /*!
+     * One effect under way.
+     */
+    struct Emitter {
+        ElementSpawn spawn;
+        int gems;
+        float centerX;
+        float centerY;
+        float cellSize;
+        //! seconds of trickle left
+        float remaining;
+        //! particles due but not yet spawned, a fraction of one between updates
+        float owed;
+    };
+
+    static ParticlePool::Spawn makeParticle(const Emitter &emitter, Pcg32 &rng);
+
+    Archetype<kMaxEmitters, Emitter> emitters_;
+    uint64_t dropped_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PARTICLEEMITTERS_H
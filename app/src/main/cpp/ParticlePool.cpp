@@ -0,0 +1,169 @@
+#include "ParticlePool.h"
+
+#include <algorithm>
+
+#include "Simd.h"
+
+bool ParticlePool::spawn(const Spawn &particle) {
+    if (size_ == kCapacity) {
+        return false;
+    }
+    const int index = size_++;
+    centerX_[index] = particle.centerX;
+    centerY_[index] = particle.centerY;
+    velocityX_[index] = particle.velocityX;
+    velocityY_[index] = particle.velocityY;
+    radius_[index] = particle.radius;
+    radiusGrowth_[index] = particle.radiusGrowth;
+    angle_[index] = particle.angle;
+    angularVelocity_[index] = particle.angularVelocity;
+    life_[index] = 0.0f;
+    maxLife_[index] = particle.maxLife;
+    baseSize_[index] = particle.baseSize;
+    endScale_[index] = particle.endScale;
+    pulseFrequency_[index] = particle.pulseFrequency;
+    pulseAmount_[index] = particle.pulseAmount;
+    layer_[index] = particle.layer;
+    return true;
+}
+
+void ParticlePool::removeAt(int index) {
+    const int last = --size_;
+    centerX_[index] = centerX_[last];
+    centerY_[index] = centerY_[last];
+    velocityX_[index] = velocityX_[last];
+    velocityY_[index] = velocityY_[last];
+    radius_[index] = radius_[last];
+    radiusGrowth_[index] = radiusGrowth_[last];
+    angle_[index] = angle_[last];
+    angularVelocity_[index] = angularVelocity_[last];
+    life_[index] = life_[last];
+    maxLife_[index] = maxLife_[last];
+    baseSize_[index] = baseSize_[last];
+    endScale_[index] = endScale_[last];
+    pulseFrequency_[index] = pulseFrequency_[last];
+    pulseAmount_[index] = pulseAmount_[last];
+    layer_[index] = layer_[last];
+}
+
+int ParticlePool::step(float deltaTimeSeconds) {
+#if RUNEBOUND_SIMD_NEON || RUNEBOUND_SIMD_SSE
+    // padding lanes past size_ are stepped too; their expiry bits are ignored below
+    const int slots = (size_ + kLanes - 1) / kLanes * kLanes;
+    const int words = (slots + 63) / 64;
+    std::fill(expired_.begin(), expired_.begin() + words, uint64_t{0});
+#if RUNEBOUND_SIMD_NEON
+    const float32x4_t dt = vdupq_n_f32(deltaTimeSeconds);
+    for (int i = 0; i < slots; i += kLanes) {
+        const float32x4_t life = vaddq_f32(vld1q_f32(&life_[i]), dt);
+        vst1q_f32(&life_[i], life);
+        vst1q_f32(&angle_[i],
+                  vaddq_f32(vld1q_f32(&angle_[i]), vmulq_f32(vld1q_f32(&angularVelocity_[i]), dt)));
+        vst1q_f32(&radius_[i],
+                  vaddq_f32(vld1q_f32(&radius_[i]), vmulq_f32(vld1q_f32(&radiusGrowth_[i]), dt)));
+        vst1q_f32(&centerX_[i],
+                  vaddq_f32(vld1q_f32(&centerX_[i]), vmulq_f32(vld1q_f32(&velocityX_[i]), dt)));
+        vst1q_f32(&centerY_[i],
+                  vaddq_f32(vld1q_f32(&centerY_[i]), vmulq_f32(vld1q_f32(&velocityY_[i]), dt)));
+
+        const uint32x4_t dead = vcgeq_f32(life, vld1q_f32(&maxLife_[i]));
+        const uint64_t bits = simd::laneMask(dead);
+        expired_[i >> 6] |= bits << (i & 63);
+    }
+#else
+    const __m128 dt = _mm_set1_ps(deltaTimeSeconds);
+    for (int i = 0; i < slots; i += kLanes) {
+        const __m128 life = _mm_add_ps(_mm_load_ps(&life_[i]), dt);
+        _mm_store_ps(&life_[i], life);
+        _mm_store_ps(&angle_[i], _mm_add_ps(_mm_load_ps(&angle_[i]),
+                                            _mm_mul_ps(_mm_load_ps(&angularVelocity_[i]), dt)));
+        _mm_store_ps(&radius_[i], _mm_add_ps(_mm_load_ps(&radius_[i]),
+                                             _mm_mul_ps(_mm_load_ps(&radiusGrowth_[i]), dt)));
+        _mm_store_ps(&centerX_[i], _mm_add_ps(_mm_load_ps(&centerX_[i]),
+                                              _mm_mul_ps(_mm_load_ps(&velocityX_[i]), dt)));
+        _mm_store_ps(&centerY_[i], _mm_add_ps(_mm_load_ps(&centerY_[i]),
+                                              _mm_mul_ps(_mm_load_ps(&velocityY_[i]), dt)));
+
+        const __m128 dead = _mm_cmpge_ps(life, _mm_load_ps(&maxLife_[i]));
+        const uint64_t bits = simd::laneMask(dead);
+        expired_[i >> 6] |= bits << (i & 63);
+    }
+#endif
+    // last to first, so the particle moved into a freed slot has already been checked
+    const int before = size_;
+    for (int word = words - 1; word >= 0; --word) {
+        uint64_t bits = expired_[word];
+        while (bits != 0) {
+            const int bit = 63 - __builtin_clzll(bits);
+            bits &= ~(uint64_t{1} << bit);
+            const int index = word * 64 + bit;
+            if (index < size_) {
+                removeAt(index);
+            }
+        }
+    }
+    return before - size_;
+#else
+    return stepScalar(deltaTimeSeconds);
+#endif
+}
+
+int ParticlePool::stepScalar(float deltaTimeSeconds) {
+    for (int i = 0; i < size_; ++i) {
+        // a product and its sum in one expression may be fused into a single rounding, which the
+        // vector paths never do, so each product gets its own statement
+        const float turn = angularVelocity_[i] * deltaTimeSeconds;
+        const float growth = radiusGrowth_[i] * deltaTimeSeconds;
+        const float driftX = velocityX_[i] * deltaTimeSeconds;
+        const float driftY = velocityY_[i] * deltaTimeSeconds;
+        life_[i] += deltaTimeSeconds;
+        angle_[i] += turn;
+        radius_[i] += growth;
+        centerX_[i] += driftX;
+        centerY_[i] += driftY;
+    }
+    const int before = size_;
+    for (int i = size_ - 1; i >= 0; --i) {
+        if (life_[i] >= maxLife_[i]) {
+            removeAt(i);
+        }
+    }
+    return before - size_;
+}
+
+int ParticlePool::emitQuads(ParticleVertex *outVertices, float z, uint8_t layer) const {
+    ParticleVertex *quad = outVertices;
+    for (int i = 0; i < size_; ++i) {
+        if (layer_[i] != layer) {
+            continue;
+        }
+        const float life = life_[i];
+        const float progress = std::min(life / maxLife_[i], 1.0f);
+        const float x = centerX_[i] + fastCos(angle_[i]) * radius_[i];
+        const float y = centerY_[i] + fastSin(angle_[i]) * radius_[i];
+        const float pulse =
+                1.0f + pulseAmount_[i] * fastSin(life * pulseFrequency_[i] * kParticleTwoPi);
+        const float scale = 1.0f + (endScale_[i] - 1.0f) * progress;
+        const float half = 0.5f * baseSize_[i] * scale * pulse;
+
+        quad[0] = ParticleVertex{x + half, y + half, z, 1.0f, 0.0f};
+        quad[1] = ParticleVertex{x - half, y + half, z, 0.0f, 0.0f};
+        quad[2] = ParticleVertex{x - half, y - half, z, 0.0f, 1.0f};
+        quad[3] = ParticleVertex{x + half, y - half, z, 1.0f, 1.0f};
+        quad += kVerticesPerParticle;
+    }
+    return static_cast<int>((quad - outVertices) / kVerticesPerParticle);
+}
+
+void ParticlePool::fillQuadIndices(uint16_t *outIndices, int quads) {
+    for (int quad = 0; quad < quads; ++quad) {
+        const auto first = static_cast<uint16_t>(quad * kVerticesPerParticle);
+        uint16_t *indices = outIndices + quad * kIndicesPerParticle;
+        indices[0] = first;
+        indices[1] = static_cast<uint16_t>(first + 1);
+        indices[2] = static_cast<uint16_t>(first + 2);
+        indices[3] = first;
+        indices[4] = static_cast<uint16_t>(first + 2);
+        indices[5] = static_cast<uint16_t>(first + 3);
+    }
+}
@@ -0,0 +1,155 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PARTICLEPOOL_H
+#define ANDROIDGLINVESTIGATIONS_PARTICLEPOOL_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+static constexpr float kParticlePi = 3.14159265f;
+static constexpr float kParticleTwoPi = 6.2831853f;
+
+/*!
+ * sin(@a radians) to within about 0.001, from two parabolas on the angle reduced to [-pi, pi].
+ * Branch-free, so loops over it vectorize.
+ */
+inline float fastSin(float radians) {
+    constexpr float kInverseTwoPi = 1.0f / kParticleTwoPi;
+    constexpr float kLinear = 4.0f / kParticlePi;
+    constexpr float kQuadratic = -4.0f / (kParticlePi * kParticlePi);
+    constexpr float kCorrection = 0.225f;
+    // rounds the turns to the nearest whole one by truncating; converts in one vector instruction
+    const float turns = radians * kInverseTwoPi;
+    const float wholeTurns =
+            static_cast<float>(static_cast<int32_t>(turns + (turns < 0.0f ? -0.5f : 0.5f)));
+    const float x = radians - kParticleTwoPi * wholeTurns;
+    const float y = kLinear * x + kQuadratic * x * std::fabs(x);
+    return kCorrection * (y * std::fabs(y) - y) + y;
+}
+
+inline float fastCos(float radians) {
+    return fastSin(radians + kParticlePi * 0.5f);
+}
+
+/*!
+ * One corner of a particle quad, laid out as the shader's position and uv attributes.
+ */
+struct ParticleVertex {
+    float x;
+    float y;
+    float z;
+    float u;
+    float v;
+};
+
+/*!
+ * The battle's element effects: a fixed pool of up to @a kCapacity particles, each orbiting a
+ * drifting point on a widening circle while its quad pulses and scales towards
+ * @a Spawn::endScale, until its life runs out. A layer per particle picks the texture it is drawn
+ * with, so one pool serves every effect and the renderer draws it a layer at a time. Each field
+ * lives in its own array so @a step can update a whole vector of particles per instruction.
+ * Nothing is allocated after construction: a spawn into a full pool is dropped, and expired
+ * particles are swapped out for the last live one so the live ones stay packed at the front.
+ */
+class ParticlePool {
+public:
+    //! particles handled per vector step
+    static constexpr int kLanes = 4;
+    static constexpr int kCapacity = 4096;
+    //! corners written per particle
+    static constexpr int kVerticesPerParticle = 4;
+    //! indices per particle: two triangles
+    static constexpr int kIndicesPerParticle = 6;
+
+    static_assert(kCapacity % 64 == 0, "whole words of expiry bits, whole vectors of particles");
+    static_assert(kCapacity * kVerticesPerParticle <= 65536, "quads are drawn with 16-bit indices");
+
+    /*!
+     * What a new particle starts out as.
+     */
+    struct Spawn {
+        float centerX;
+        float centerY;
+        //! how far the centre drifts per second
+        float velocityX;
+        float velocityY;
+        //! distance from the centre, and how much it grows per second
+        float radius;
+        float radiusGrowth;
+        //! position on the circle in radians, and how fast it turns per second
+        float angle;
+        float angularVelocity;
+        //! seconds it lives
+        float maxLife;
+        //! width and height of its quad at birth
+        float baseSize;
+        //! its size at the end of its life, as a fraction of @a baseSize
+        float endScale;
+        //! pulses per second, each swelling and shrinking the quad by @a pulseAmount of its size
+        float pulseFrequency;
+        float pulseAmount;
+        uint8_t layer;
+    };
+
+    inline int size() const { return size_; }
+
+    inline bool empty() const { return size_ == 0; }
+
+    inline int available() const { return kCapacity - size_; }
+
+    inline void clear() { size_ = 0; }
+
+    //! @return false, leaving the pool unchanged, if it is full
+    bool spawn(const Spawn &particle);
+
+    /*!
+     * Advances every particle by @a deltaTimeSeconds and removes those that have lived out their
+     * life.
+     * @return the number removed
+     */
+    int step(float deltaTimeSeconds);
+
+    /*!
+     * @a step without vector instructions, for targets that have neither NEON nor SSE. The sim's
+     * --particles-check runs both on the same spawns and expects identical pools.
+     */
+    int stepScalar(float deltaTimeSeconds);
+
+    /*!
+     * Writes a quad for every particle in @a layer into @a outVertices, which must hold
+     * @a size() * @a kVerticesPerParticle vertices, at depth @a z. The corners follow the order
+     * @a fillQuadIndices draws them in.
+     * @return the number of quads written
+     */
+    int emitQuads(ParticleVertex *outVertices, float z, uint8_t layer) const;
+
+    /*!
+     * Fills @a outIndices with two triangles for each of @a quads quads as @a emitQuads lays
+     * them out; needed once per buffer.
+     */
+    static void fillQuadIndices(uint16_t *outIndices, int quads);
+
+private:
+    //! moves the last particle into @a index
+    void removeAt(int index);
+
+    alignas(16) std::array<float, kCapacity> centerX_{};
+    alignas(16) std::array<float, kCapacity> centerY_{};
+    alignas(16) std::array<float, kCapacity> velocityX_{};
+    alignas(16) std::array<float, kCapacity> velocityY_{};
+    alignas(16) std::array<float, kCapacity> radius_{};
+    alignas(16) std::array<float, kCapacity> radiusGrowth_{};
+    alignas(16) std::array<float, kCapacity> angle_{};
+    alignas(16) std::array<float, kCapacity> angularVelocity_{};
+    alignas(16) std::array<float, kCapacity> life_{};
+    alignas(16) std::array<float, kCapacity> maxLife_{};
+    alignas(16) std::array<float, kCapacity> baseSize_{};
+    alignas(16) std::array<float, kCapacity> endScale_{};
+    alignas(16) std::array<float, kCapacity> pulseFrequency_{};
+    alignas(16) std::array<float, kCapacity> pulseAmount_{};
+    std::array<uint8_t, kCapacity> layer_{};
+    //! a set bit marks a particle that expired in the step under way
+    std::array<uint64_t, kCapacity / 64> expired_{};
+    int size_ = 0;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PARTICLEPOOL_H
@@ -0,0 +1,131 @@
+#ifndef ANDROIDGLINVESTIGATIONS_REFILLQUEUE_H
+#define ANDROIDGLINVESTIGATIONS_REFILLQUEUE_H
+
+#include <array>
+#include <cstdint>
+
+#include "BoardEngine.h"
+#include "Random.h"
+
+/*!
+ * The gems waiting above each column of a @a Rows x @a Cols board, rolled before they are needed.
+ * A column queue holds up to @a Rows gems packed into one word, the gem that lands lowest in the
+ * next refill first; a refill step never takes more than that from one column. Topping up after
+ * every refill keeps all queues full between turns, so what the next swap drops into each column
+ * is known before it is made, and a column's refills never depend on how many gems the columns
+ * next to it took.
+ */
+template<int Rows, int Cols, int GemTypes>
+class RefillQueues {
+public:
+    static constexpr int kGemBits = GemTypes <= 2 ? 1 : GemTypes <= 4 ? 2 : GemTypes <= 8 ? 3 : 4;
+    static constexpr int kDepth = Rows;
+
+    static_assert(GemTypes <= 16, "a queued gem takes at most four bits");
+    static_assert(kDepth * kGemBits <= 64, "a column queue is packed into one 64-bit word");
+
+    //! bytes needed to store full queues at @a kGemBits per gem
+    static constexpr int kPackedBytes = (Cols * kDepth * kGemBits + 7) / 8;
+
+    typedef std::array<uint8_t, kPackedBytes> Packed;
+
+    inline int size(int col) const { return counts_[col]; }
+
+    inline bool full() const {
+        for (const auto count: counts_) {
+            if (count != kDepth) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! the gem @a position places behind the front of @a col's queue, which must hold it
+    inline GemType peek(int col, int position) const {
+        return static_cast<GemType>((gems_[col] >> (position * kGemBits)) & kGemMask);
+    }
+
+    //! takes the front gem of @a col's queue; it must not be empty
+    inline GemType pop(int col) {
+        const GemType gem = peek(col, 0);
+        gems_[col] >>= kGemBits;
+        --counts_[col];
+        return gem;
+    }
+
+    /*!
+     * Rolls a gem for every free slot, columns left to right and each queue from its front to its
+     * back, through @a sampler from @a rng and @a bits.
+     */
+    template<typename Sampler, typename Rng>
+    void topUp(const Sampler &sampler, Rng &rng, RandomBits &bits) {
+        for (int col = 0; col < Cols; ++col) {
+            for (; counts_[col] < kDepth; ++counts_[col]) {
+                gems_[col] |= static_cast<uint64_t>(sampler(rng, bits))
+                        << (counts_[col] * kGemBits);
+            }
+        }
+    }
+
+    //! @return false if some queue is not full; only full queues are stored
+    bool pack(Packed &outPacked) const {
+        if (!full()) {
+            return false;
+        }
+        outPacked.fill(0);
+        int bit = 0;
+        for (int col = 0; col < Cols; ++col) {
+            for (int position = 0; position < kDepth; ++position, bit += kGemBits) {
+                const uint32_t gem = static_cast<uint32_t>(peek(col, position)) << (bit & 7);
+                outPacked[bit >> 3] |= static_cast<uint8_t>(gem);
+                if ((bit & 7) + kGemBits > 8) {
+                    outPacked[(bit >> 3) + 1] |= static_cast<uint8_t>(gem >> 8);
+                }
+            }
+        }
+        return true;
+    }
+
+    //! @return false, leaving the queues unchanged, if @a packed holds a gem type out of range
+    bool unpack(const Packed &packed) {
+        std::array<uint64_t, Cols> gems{};
+        int bit = 0;
+        for (int col = 0; col < Cols; ++col) {
+            for (int position = 0; position < kDepth; ++position, bit += kGemBits) {
+                uint32_t word = packed[bit >> 3];
+                if ((bit & 7) + kGemBits > 8) {
+                    word |= static_cast<uint32_t>(packed[(bit >> 3) + 1]) << 8;
+                }
+                const uint32_t gem = (word >> (bit & 7)) & kGemMask;
+                if (gem >= GemTypes) {
+                    return false;
+                }
+                gems[col] |= static_cast<uint64_t>(gem) << (position * kGemBits);
+            }
+        }
+        gems_ = gems;
+        counts_.fill(kDepth);
+        return true;
+    }
+
+    inline void clear() {
+        gems_ = {};
+        counts_ = {};
+    }
+
+    inline bool operator==(const RefillQueues &other) const {
+        return gems_ == other.gems_ && counts_ == other.counts_;
+    }
+
+private:
+    static constexpr uint64_t kGemMask = (uint64_t{1} << kGemBits) - 1;
+
+    std::array<uint64_t, Cols> gems_{};
+    std::array<uint8_t, Cols> counts_{};
+};
+
+//! The refill queues of the board the game currently plays on.
+typedef RefillQueues<GameBoard::kRows, GameBoard::kColumns, GameBoard::kGemTypes>
+        GameRefillQueues;
+
+#endif //ANDROIDGLINVESTIGATIONS_REFILLQUEUE_H
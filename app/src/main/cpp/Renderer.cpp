@@ -7,7 +7,7 @@
 #include <array>
 #include <cmath>
 #include <memory>
-#include <random>
+#include <string>
 #include <utility>
 #include <vector>
 #include <android/imagedecoder.h>
@@ -17,6 +17,8 @@
 #include "Utility.h"
 #include "TextureAsset.h"
 
+static_assert(sizeof(ParticleVertex) == sizeof(Vertex), "particles stream into the Vertex layout");
+
 //! executes glGetString and outputs the result to logcat
 #define PRINT_GL_STRING(s) {aout << #s": "<< glGetString(s) << std::endl;}
 
@@ -90,9 +92,13 @@ static constexpr float kProjectionNearPlane = -1.f;
  */
 static constexpr float kProjectionFarPlane = 1.f;
 
-static constexpr int kBoardRows = 8;
-static constexpr int kBoardColumns = 5;
+static constexpr int kBoardRows = GameBoard::kRows;
+static constexpr int kBoardColumns = GameBoard::kColumns;
 static constexpr float kGemVisualScale = 0.8f;
+//! the glow behind a bomb or prism rune, relative to the gem
+static constexpr float kSpecialGlowScale = 1.2f;
+//! the thickness of the bar across a row or column blast rune, relative to the gem
+static constexpr float kBlastBarScale = 0.18f;
 
 static constexpr float kBoardPixelWidth = 1022.f;
 static constexpr float kBoardPixelHeight = 1535.f;
@@ -104,16 +110,10 @@ static constexpr float kBoardMarginBottomPx = 80.f;
 static constexpr float kBoardMarginScale = 0.85f;
 static constexpr float kResultBannerWidthScale = 0.6f;
 
-static constexpr int kFireMatchDamage = 10;
-static constexpr int kWaterMatchHeal = 6;
-static constexpr int kAirMatchDamage = 4;
-static constexpr int kEarthMatchShield = 12;
-static constexpr float kWindEffectMinLife = 0.8f;
-static constexpr float kWindEffectMaxLife = 1.4f;
-static constexpr int kWindSwirlCount = 6;
-static constexpr float kTwoPi = 6.2831853f;
+static constexpr float kParticleZ = 0.02f;
 
 Renderer::~Renderer() {
+    worker_.stop();
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (context_ != EGL_NO_CONTEXT) {
@@ -151,7 +151,7 @@ void Renderer::render() {
     }
 
     updateRuneAnimation(deltaTime);
-    updateWindEffects(deltaTime);
+    updateParticles(deltaTime);
 
     // When the renderable area changes, the projection matrix has to also be updated. This is true
     // even if you change from the sample orthographic projection matrix as your aspect ratio has
@@ -187,10 +187,13 @@ void Renderer::render() {
     // Render all the models. There's no depth testing in this sample so they're accepted in the
     // order provided. But the sample EGL setup requests a 24 bit depth buffer so you could
     // configure it at the end of initRenderer
-    if (!models_.empty()) {
-        for (const auto &model: models_) {
-            shader_->drawModel(model);
-        }
+    const size_t particleLayer = std::min(particleLayer_, models_.size());
+    for (size_t i = 0; i < particleLayer; ++i) {
+        shader_->drawModel(models_[i]);
+    }
+    drawParticles();
+    for (size_t i = particleLayer; i < models_.size(); ++i) {
+        shader_->drawModel(models_[i]);
     }
 
     // Present the rendered image. This is an implicit glFlush.
@@ -313,7 +316,8 @@ void Renderer::updateRenderArea() {
  * @brief Create any demo models we want for this demo.
  */
 void Renderer::createModels() {
-    if (width_ <= 0 || height_ <= 0 || !boardReady_) {
+    // nothing to draw until the worker has published the first frame
+    if (width_ <= 0 || height_ <= 0 || !boardReady_ || !frame_) {
         return;
     }
 
@@ -353,10 +357,20 @@ void Renderer::createModels() {
         }
     }
 
-    if (!spWindSwirlTexture_) {
-        spWindSwirlTexture_ = TextureAsset::loadAsset(assetManager, "puzzle/circle.png");
-        if (!spWindSwirlTexture_) {
-            spWindSwirlTexture_ = TextureAsset::createSolidColorTexture(200, 255, 255, 180);
+    for (int layer = 1; layer < kElementSpawnCount; ++layer) {
+        if (spParticleTextures_[layer]) {
+            continue;
+        }
+        const EmitterDescriptor &emitter = kElementEmitters[layer];
+        if (emitter.assetPath) {
+            spParticleTextures_[layer] = TextureAsset::loadAsset(assetManager, emitter.assetPath);
+        }
+        if (!spParticleTextures_[layer]) {
+            spParticleTextures_[layer] = TextureAsset::createSolidColorTexture(
+                    emitter.fallbackColor[0],
+                    emitter.fallbackColor[1],
+                    emitter.fallbackColor[2],
+                    emitter.fallbackColor[3]);
         }
     }
 
@@ -381,6 +395,10 @@ void Renderer::createModels() {
         }
     }
 
+    if (!spBombGlowTexture_) {
+        spBombGlowTexture_ = TextureAsset::createSolidColorTexture(255, 150, 40, 200);
+    }
+
     models_.clear();
 
     const float worldHeight = kProjectionHalfHeight * 2.0f;
@@ -439,163 +457,68 @@ void Renderer::createModels() {
 
     for (int row = 0; row < kBoardRows; ++row) {
         for (int col = 0; col < kBoardColumns; ++col) {
-            const Rune &rune = runeAt(row, col);
-            if (rune.type == GemType::None) {
-                continue;
-            }
-
-            auto texture = textureForGem(rune.type);
+            const int index = GameBoard::cellIndex(row, col);
+            auto texture = textureForGem(runeTypes_[index]);
             if (!texture) {
                 continue;
             }
 
-            float gemCenterX = rune.currentX;
-            float gemCenterY = rune.currentY;
+            float gemCenterX = runeMotion_.x(index);
+            float gemCenterY = runeMotion_.y(index);
 
-            if (!rune.positionInitialized) {
+            if (!runeMotion_.placed(index)) {
                 const auto center = cellCenter(row, col);
                 gemCenterX = center.first;
                 gemCenterY = center.second;
             }
 
+            const SpecialRune special = frame_->board.special(index);
+            if (special == SpecialRune::Bomb || special == SpecialRune::Prism) {
+                const float glowHalfWidth = gemHalfWidth * kSpecialGlowScale;
+                const float glowHalfHeight = gemHalfHeight * kSpecialGlowScale;
+                models_.emplace_back(buildQuadModel(
+                        gemCenterX - glowHalfWidth,
+                        gemCenterY + glowHalfHeight,
+                        gemCenterX + glowHalfWidth,
+                        gemCenterY - glowHalfHeight,
+                        0.0f,
+                        special == SpecialRune::Bomb ? spBombGlowTexture_ : spWhiteTexture_));
+            }
+
             models_.emplace_back(buildQuadModel(gemCenterX - gemHalfWidth,
                                                 gemCenterY + gemHalfHeight,
                                                 gemCenterX + gemHalfWidth,
                                                 gemCenterY - gemHalfHeight,
                                                 0.0f,
                                                 texture));
-        }
-    }
 
-    if (!windSwirls_.empty() && spWindSwirlTexture_) {
-        for (const auto &swirl: windSwirls_) {
-            if (swirl.life >= swirl.maxLife) {
-                continue;
+            if (special == SpecialRune::RowBlast || special == SpecialRune::ColumnBlast) {
+                const bool alongRow = special == SpecialRune::RowBlast;
+                const float barHalfWidth = alongRow ? gemHalfWidth : gemHalfWidth * kBlastBarScale;
+                const float barHalfHeight =
+                        alongRow ? gemHalfHeight * kBlastBarScale : gemHalfHeight;
+                models_.emplace_back(buildQuadModel(gemCenterX - barHalfWidth,
+                                                    gemCenterY + barHalfHeight,
+                                                    gemCenterX + barHalfWidth,
+                                                    gemCenterY - barHalfHeight,
+                                                    0.0f,
+                                                    spWhiteTexture_));
             }
-            const float progress = std::clamp(swirl.life / swirl.maxLife, 0.0f, 1.0f);
-            const float radius = swirl.radius + swirl.radiusGrowth * swirl.life;
-            const float angle = swirl.angle;
-            const float offsetX = std::cos(angle) * radius;
-            const float offsetY = std::sin(angle) * radius;
-            const float pulse = 1.0f + 0.1f * std::sin(swirl.life * swirl.pulseFrequency * kTwoPi);
-            const float size = swirl.baseSize * (1.0f - 0.3f * progress) * pulse;
-            const float halfSize = size * 0.5f;
-
-            models_.emplace_back(buildQuadModel(swirl.centerX + offsetX - halfSize,
-                                                swirl.centerY + offsetY + halfSize,
-                                                swirl.centerX + offsetX + halfSize,
-                                                swirl.centerY + offsetY - halfSize,
-                                                0.02f,
-                                                spWindSwirlTexture_));
         }
     }
 
+    particleLayer_ = models_.size();
+
     const float screenW = static_cast<float>(width_);
     const float screenH = static_cast<float>(height_);
     if (screenW > 0.0f && screenH > 0.0f) {
-        const float worldWidthToPixel = worldWidth / screenW;
-        const float worldHeightToPixel = worldHeight / screenH;
-
-        auto rectFromTopLeft = [&](float leftPx,
-                                   float topPx,
-                                   float widthPx,
-                                   float heightPx) {
-            const float widthWorld = widthPx * worldWidthToPixel;
-            const float heightWorld = heightPx * worldHeightToPixel;
-            const float leftWorld = -worldWidth * 0.5f + (leftPx / screenW) * worldWidth;
-            const float topWorld = kProjectionHalfHeight - (topPx / screenH) * worldHeight;
-            const float bottomWorld = topWorld - heightWorld;
-            return std::array<float, 4>{leftWorld, bottomWorld, widthWorld, heightWorld};
-        };
-
-        const float heroWidthPx = 200.0f;
-        const float heroHeightPx = 240.0f;
-        const float heroLeftPx = screenW * 0.5f - heroWidthPx * 0.5f;
-        const float heroTopPx = screenH - heroHeightPx - 40.0f;
-        const auto heroRect = rectFromTopLeft(heroLeftPx, heroTopPx, heroWidthPx, heroHeightPx);
-        renderTexture(spHeroTexture_,
-                      heroRect[0],
-                      heroRect[1],
-                      heroRect[2],
-                      heroRect[3],
-                      0.05f);
-
-        const float enemyWidthPx = 200.0f;
-        const float enemyHeightPx = 240.0f;
-        const float enemyLeftPx = screenW * 0.5f - enemyWidthPx * 0.5f;
-        const float enemyTopPx = 40.0f;
-        const auto enemyRect = rectFromTopLeft(enemyLeftPx,
-                                               enemyTopPx,
-                                               enemyWidthPx,
-                                               enemyHeightPx);
-        renderTexture(spEnemyTexture_,
-                      enemyRect[0],
-                      enemyRect[1],
-                      enemyRect[2],
-                      enemyRect[3],
-                      0.05f);
-
-        const float hpBarWidthPx = 200.0f;
-        const float hpBarHeightPx = 20.0f;
-        const float heroHpTopPx = heroTopPx - hpBarHeightPx;
-        const auto heroHpRect = rectFromTopLeft(heroLeftPx,
-                                                heroHpTopPx,
-                                                hpBarWidthPx,
-                                                hpBarHeightPx);
-        drawHPBar(heroHP_,
-                  heroMaxHP_,
-                  heroHpRect[0],
-                  heroHpRect[1],
-                  heroHpRect[2],
-                  heroHpRect[3]);
-
-        if (heroShield_ > 0) {
-            const float shieldHeightPx = 10.0f;
-            const float shieldGapPx = 6.0f;
-            const auto heroShieldRect = rectFromTopLeft(heroLeftPx,
-                                                        heroHpTopPx - shieldHeightPx - shieldGapPx,
-                                                        hpBarWidthPx,
-                                                        shieldHeightPx);
-            renderQuad(heroShieldRect[0],
-                       heroShieldRect[1],
-                       heroShieldRect[2],
-                       heroShieldRect[3],
-                       0.15f,
-                       0.3f,
-                       0.18f,
-                       1.0f,
-                       0.06f);
-            float shieldRatio = static_cast<float>(heroShield_) / static_cast<float>(heroMaxShield_);
-            shieldRatio = std::clamp(shieldRatio, 0.0f, 1.0f);
-            if (shieldRatio > 0.0f) {
-                renderQuad(heroShieldRect[0],
-                           heroShieldRect[1],
-                           heroShieldRect[2] * shieldRatio,
-                           heroShieldRect[3],
-                           0.4f,
-                           0.8f,
-                           0.4f,
-                           1.0f,
-                           0.05f);
-            }
-        }
-
-        const float enemyHpTopPx = enemyTopPx + enemyHeightPx;
-        const auto enemyHpRect = rectFromTopLeft(enemyLeftPx,
-                                                 enemyHpTopPx,
-                                                 hpBarWidthPx,
-                                                 hpBarHeightPx);
-        drawHPBar(enemyHP_,
-                  enemyMaxHP_,
-                  enemyHpRect[0],
-                  enemyHpRect[1],
-                  enemyHpRect[2],
-                  enemyHpRect[3]);
+        drawActors(screenW, screenH, worldWidth, worldHeight);
     }
 
-    if (gameState_ == GameState::VICTORY || gameState_ == GameState::DEFEAT) {
+    const GameState gameState = frame_ ? frame_->state : GameState::START;
+    if (gameState == GameState::VICTORY || gameState == GameState::DEFEAT) {
         std::shared_ptr<TextureAsset> spTextTexture;
-        if (gameState_ == GameState::VICTORY) {
+        if (gameState == GameState::VICTORY) {
             if (!spVictoryTexture_) {
                 spVictoryTexture_ = TextureAsset::createTextTexture(
                         "The battle of Fire, Water, Air, and Earth has begun!",
@@ -605,7 +528,7 @@ void Renderer::createModels() {
                         255);
             }
             spTextTexture = spVictoryTexture_;
-        } else if (gameState_ == GameState::DEFEAT) {
+        } else if (gameState == GameState::DEFEAT) {
             if (!spDefeatTexture_) {
                 spDefeatTexture_ = TextureAsset::createTextTexture("DEFEAT", 255, 100, 100, 255);
             }
@@ -640,345 +563,154 @@ void Renderer::ensureBoardInitialized() {
         return;
     }
 
-    board_.assign(kBoardRows * kBoardColumns, Rune{});
+    runeTypes_.fill(GemType::None);
+    runeMotion_.clear();
+    scene_.stageDuel();
+    particleVertices_.resize(ParticlePool::kCapacity * ParticlePool::kVerticesPerParticle);
+    particleIndices_.resize(ParticlePool::kCapacity * ParticlePool::kIndicesPerParticle);
+    ParticlePool::fillQuadIndices(particleIndices_.data(), ParticlePool::kCapacity);
     boardReady_ = true;
 
-    do {
-        for (int row = 0; row < kBoardRows; ++row) {
-            for (int col = 0; col < kBoardColumns; ++col) {
-                setGem(row, col, randomGem());
-            }
-        }
-    } while (!findMatches().empty());
-
-    heroHP_ = heroMaxHP_;
-    enemyHP_ = enemyMaxHP_;
-    heroShield_ = 0;
-    gameState_ = GameState::PLAYING;
-    sceneDirty_ = true;
-}
-
-Renderer::GemType Renderer::randomGem() {
-    int value = gemDistribution_(rng_);
-    switch (value) {
-        case 0:
-            return GemType::Fire;
-        case 1:
-            return GemType::Water;
-        case 2:
-            return GemType::Air;
-        default:
-            return GemType::Earth;
-    }
-}
-
-Renderer::GemType Renderer::getGem(int row, int col) const {
-    if (row < 0 || row >= kBoardRows || col < 0 || col >= kBoardColumns) {
-        return GemType::None;
+    worker_.session().start();
+    if (app_->activity && app_->activity->internalDataPath) {
+        worker_.recordReplay(std::string(app_->activity->internalDataPath) + "/last_session.rbr");
     }
-    const size_t index = static_cast<size_t>(row * kBoardColumns + col);
-    return board_[index].type;
+    worker_.start();
+    sceneDirty_ = true;
 }
 
-void Renderer::setGem(int row, int col, GemType type) {
-    if (row < 0 || row >= kBoardRows || col < 0 || col >= kBoardColumns) {
-        return;
-    }
-    Rune &rune = board_[static_cast<size_t>(row * kBoardColumns + col)];
-    if (type == GemType::None) {
-        rune = Rune{};
-        return;
-    }
-
-    rune.type = type;
-    rune.positionInitialized = false;
-    updateRuneTarget(row, col, rune);
+BalanceConfig Renderer::balanceFor(HeroClass heroClass) {
+    BalanceConfig balance;
+    balance.heroClass = heroClass;
+    return balance;
 }
 
-std::vector<Renderer::MatchGroup> Renderer::findMatches() const {
-    std::vector<MatchGroup> matches;
+bool Renderer::saveSnapshot(SessionSnapshot &outSnapshot) {
     if (!boardReady_) {
-        return matches;
-    }
-
-    auto emitHorizontalRun = [&](GemType type, int row, int startCol, int count) {
-        if (count < 3 || type == GemType::None) {
-            return;
-        }
-        MatchGroup group{type, {}};
-        group.cells.reserve(static_cast<size_t>(count));
-        for (int c = startCol; c < startCol + count; ++c) {
-            group.cells.emplace_back(row, c);
-        }
-        matches.push_back(std::move(group));
-    };
-
-    for (int row = 0; row < kBoardRows; ++row) {
-        GemType current = GemType::None;
-        int runStart = 0;
-        int count = 0;
-        for (int col = 0; col < kBoardColumns; ++col) {
-            GemType type = getGem(row, col);
-            if (type != GemType::None && type == current) {
-                ++count;
-            } else {
-                emitHorizontalRun(current, row, runStart, count);
-                if (type == GemType::None) {
-                    current = GemType::None;
-                    count = 0;
-                } else {
-                    current = type;
-                    count = 1;
-                    runStart = col;
-                }
-            }
-        }
-        emitHorizontalRun(current, row, runStart, count);
-    }
-
-    auto emitVerticalRun = [&](GemType type, int col, int startRow, int count) {
-        if (count < 3 || type == GemType::None) {
-            return;
-        }
-        MatchGroup group{type, {}};
-        group.cells.reserve(static_cast<size_t>(count));
-        for (int r = startRow; r < startRow + count; ++r) {
-            group.cells.emplace_back(r, col);
-        }
-        matches.push_back(std::move(group));
-    };
-
-    for (int col = 0; col < kBoardColumns; ++col) {
-        GemType current = GemType::None;
-        int runStart = 0;
-        int count = 0;
-        for (int row = 0; row < kBoardRows; ++row) {
-            GemType type = getGem(row, col);
-            if (type != GemType::None && type == current) {
-                ++count;
-            } else {
-                emitVerticalRun(current, col, runStart, count);
-                if (type == GemType::None) {
-                    current = GemType::None;
-                    count = 0;
-                } else {
-                    current = type;
-                    count = 1;
-                    runStart = row;
-                }
-            }
-        }
-        emitVerticalRun(current, col, runStart, count);
+        return false;
     }
-
-    return matches;
+    worker_.stop();
+    // snapshots hold settled boards only, so land the cascade in progress first
+    worker_.session().processMatches();
+    const bool saved = worker_.session().saveSnapshot(outSnapshot);
+    worker_.start();
+    return saved;
 }
 
-void Renderer::removeMatches(const std::vector<MatchGroup> &matches) {
-    std::vector<bool> cleared(board_.size(), false);
-    for (const auto &group: matches) {
-        for (const auto &cell: group.cells) {
-            const int row = cell.first;
-            const int col = cell.second;
-            if (row < 0 || row >= kBoardRows || col < 0 || col >= kBoardColumns) {
-                continue;
-            }
-            const size_t index = static_cast<size_t>(row * kBoardColumns + col);
-            if (index >= cleared.size() || cleared[index]) {
-                continue;
-            }
-            setGem(row, col, GemType::None);
-            cleared[index] = true;
-        }
+bool Renderer::restoreSnapshot(const SessionSnapshot &snapshot) {
+    ensureBoardInitialized();
+    worker_.stop();
+    const bool restored = worker_.session().restoreSnapshot(snapshot);
+    if (restored) {
+        // the seed and the swaps from here on no longer reproduce the game
+        worker_.recordReplay(std::string());
+        hasSelectedCell_ = false;
+    } else {
+        aout << "Discarding saved game that could not be restored" << std::endl;
     }
+    worker_.start();
+    return restored;
 }
 
-void Renderer::applyMatchEffects(const std::vector<MatchGroup> &matches) {
-    if (matches.empty()) {
+void Renderer::applyFrame(const SessionFrame &frame) {
+    if (frame.reset) {
+        // effects from before a reset have no runes left to play on
+        combatCursor_.next = frame.combatEventEnd;
+        resetRunes(frame.board);
         return;
     }
-
-    std::array<int, 4> gemCounts = {0, 0, 0, 0};
-    std::vector<bool> counted(board_.size(), false);
-    std::vector<std::pair<int, int>> airMatchCells;
-    for (const auto &group: matches) {
-        const int typeIndex = static_cast<int>(group.type);
-        if (typeIndex < 0 || typeIndex >= static_cast<int>(gemCounts.size())) {
-            continue;
-        }
-
-        if (group.type == GemType::Air) {
-            airMatchCells.insert(airMatchCells.end(), group.cells.begin(), group.cells.end());
-        }
-
-        for (const auto &cell: group.cells) {
-            const int row = cell.first;
-            const int col = cell.second;
-            if (row < 0 || row >= kBoardRows || col < 0 || col >= kBoardColumns) {
-                continue;
-            }
-            const size_t index = static_cast<size_t>(row * kBoardColumns + col);
-            if (index >= counted.size() || counted[index]) {
-                continue;
-            }
-            counted[index] = true;
-            ++gemCounts[typeIndex];
-        }
-    }
-
-    bool statsChanged = false;
-
-    const int fireCount = gemCounts[static_cast<int>(GemType::Fire)];
-    if (fireCount > 0) {
-        const int newEnemyHP = std::max(0, enemyHP_ - kFireMatchDamage * fireCount);
-        if (newEnemyHP != enemyHP_) {
-            enemyHP_ = newEnemyHP;
-            statsChanged = true;
-        }
+    if (frame.hasSwap()) {
+        swapRunes(frame.swapFirst, frame.swapSecond);
     }
-
-    const int waterCount = gemCounts[static_cast<int>(GemType::Water)];
-    if (waterCount > 0) {
-        const int newHeroHP = std::min(heroMaxHP_, heroHP_ + kWaterMatchHeal * waterCount);
-        if (newHeroHP != heroHP_) {
-            heroHP_ = newHeroHP;
-            statsChanged = true;
+    worker_.combatEvents().poll(combatCursor_, frame.combatEventEnd,
+                                [this](const CombatEvent &event) {
+        if (event.kind == CombatEventKind::Spawn) {
+            spawnElementEffect(event.spawn, event.cells);
         }
+    });
+    if (frame.cleared.any()) {
+        clearRunes(frame.cleared);
     }
-
-    const int airCount = gemCounts[static_cast<int>(GemType::Air)];
-    if (airCount > 0) {
-        const int newEnemyHP = std::max(0, enemyHP_ - kAirMatchDamage * airCount);
-        if (newEnemyHP != enemyHP_) {
-            enemyHP_ = newEnemyHP;
-            statsChanged = true;
-        }
+    if (frame.gravity.moved.any() || frame.gravity.refilled.any()) {
+        dropRunes(frame.gravity, frame.board);
     }
+}
 
-    const int earthCount = gemCounts[static_cast<int>(GemType::Earth)];
-    if (earthCount > 0) {
-        const int newShield = std::min(heroMaxShield_, heroShield_ + kEarthMatchShield * earthCount);
-        if (newShield != heroShield_) {
-            heroShield_ = newShield;
-            statsChanged = true;
-        }
+void Renderer::resetRunes(const GameBoard &board) {
+    runeMotion_.clear();
+    for (int index = 0; index < GameBoard::kCells; ++index) {
+        runeTypes_[index] = board.at(index);
+        updateRuneTarget(index);
     }
+    sceneDirty_ = true;
+}
 
-    if (!airMatchCells.empty()) {
-        spawnWindEffect(airMatchCells);
-    }
+void Renderer::swapRunes(int firstIndex, int secondIndex) {
+    std::swap(runeTypes_[firstIndex], runeTypes_[secondIndex]);
+    runeMotion_.swap(firstIndex, secondIndex);
+    updateRuneTarget(firstIndex);
+    updateRuneTarget(secondIndex);
+    runesMoving_ = true;
+    sceneDirty_ = true;
+}
 
-    if (statsChanged) {
-        sceneDirty_ = true;
-    }
+void Renderer::clearRunes(const BoardMask &cells) {
+    cells.forEach([this](int index) {
+        runeTypes_[index] = GemType::None;
+        runeMotion_.reset(index);
+    });
+    sceneDirty_ = true;
+}
 
-    if (gameState_ == GameState::PLAYING) {
-        if (enemyHP_ <= 0) {
-            gameState_ = GameState::VICTORY;
-            sceneDirty_ = true;
-        } else if (heroHP_ <= 0) {
-            gameState_ = GameState::DEFEAT;
-            sceneDirty_ = true;
+void Renderer::dropRunes(const GameBoard::Gravity &gravity, const GameBoard &board) {
+    // bottom up, so every rune is picked up before another one lands on it
+    for (int index = GameBoard::kCells - 1; index >= 0; --index) {
+        if (gravity.moved.test(index)) {
+            runeTypes_[index] = runeTypes_[index - gravity.fallRows[index] * GameBoard::kColumns];
         }
     }
+    // rows go down the screen, so a fall of one row is one cell height lower
+    runeMotion_.fall(gravity, -cellHeight_);
+
+    gravity.refilled.forEach([this, &gravity, &board](int index) {
+        runeTypes_[index] = board.at(index);
+        runeMotion_.reset(index);
+        if (boardGeometryValid_) {
+            // new runes start stacked above the board and fall as far as the runes they join
+            const auto center = cellCenter(GameBoard::rowOf(index), GameBoard::columnOf(index));
+            runeMotion_.place(index, center.first,
+                              center.second + gravity.fallRows[index] * cellHeight_);
+        }
+        updateRuneTarget(index);
+    });
+    runesMoving_ = true;
 }
 
-void Renderer::spawnWindEffect(const std::vector<std::pair<int, int>> &cells) {
-    if (cells.empty() || !boardGeometryValid_) {
+void Renderer::spawnElementEffect(ElementSpawn spawn, const BoardMask &cells) {
+    if (cells.none() || !boardGeometryValid_) {
         return;
     }
 
     float accumulatedX = 0.0f;
     float accumulatedY = 0.0f;
     int validCount = 0;
-    for (const auto &cell: cells) {
-        const int row = cell.first;
-        const int col = cell.second;
-        if (row < 0 || row >= kBoardRows || col < 0 || col >= kBoardColumns) {
-            continue;
-        }
-        const auto center = cellCenter(row, col);
+    cells.forEach([&](int index) {
+        const auto center = cellCenter(GameBoard::rowOf(index), GameBoard::columnOf(index));
         accumulatedX += center.first;
         accumulatedY += center.second;
         ++validCount;
-    }
+    });
 
     if (validCount <= 0) {
         return;
     }
 
-    const float effectCenterX = accumulatedX / static_cast<float>(validCount);
-    const float effectCenterY = accumulatedY / static_cast<float>(validCount);
-    const float baseSize = std::min(cellWidth_, cellHeight_);
-    if (baseSize <= 0.0f) {
-        return;
-    }
-
-    std::uniform_real_distribution<float> angleDist(0.0f, kTwoPi);
-    std::uniform_real_distribution<float> radiusDist(baseSize * 0.2f, baseSize * 0.55f);
-    std::uniform_real_distribution<float> lifeDist(kWindEffectMinLife, kWindEffectMaxLife);
-    std::uniform_real_distribution<float> speedDist(3.0f, 6.0f);
-    std::uniform_real_distribution<float> sizeDist(baseSize * 0.4f, baseSize * 0.7f);
-    std::uniform_real_distribution<float> growthDist(-baseSize * 0.05f, baseSize * 0.08f);
-    std::uniform_real_distribution<float> pulseDist(0.8f, 1.2f);
-
-    windSwirls_.reserve(windSwirls_.size() + static_cast<size_t>(kWindSwirlCount));
-    for (int i = 0; i < kWindSwirlCount; ++i) {
-        WindSwirl swirl{};
-        swirl.centerX = effectCenterX;
-        swirl.centerY = effectCenterY;
-        swirl.radius = radiusDist(rng_);
-        swirl.angularVelocity = speedDist(rng_);
-        swirl.angle = angleDist(rng_);
-        swirl.life = 0.0f;
-        swirl.maxLife = lifeDist(rng_);
-        swirl.baseSize = sizeDist(rng_);
-        swirl.pulseFrequency = pulseDist(rng_);
-        swirl.radiusGrowth = growthDist(rng_);
-        windSwirls_.push_back(swirl);
-    }
-
-    sceneDirty_ = true;
-}
-
-void Renderer::applyGravityAndFill() {
-    for (int col = 0; col < kBoardColumns; ++col) {
-        int writeRow = kBoardRows - 1;
-        for (int row = kBoardRows - 1; row >= 0; --row) {
-            Rune &currentRune = runeAt(row, col);
-            if (currentRune.type == GemType::None) {
-                continue;
-            }
-
-            if (writeRow != row) {
-                Rune movedRune = currentRune;
-                currentRune = Rune{};
-                Rune &destinationRune = runeAt(writeRow, col);
-                destinationRune = movedRune;
-                updateRuneTarget(writeRow, col, destinationRune);
-            } else {
-                updateRuneTarget(row, col, currentRune);
-            }
-
-            --writeRow;
-        }
-        for (int row = writeRow; row >= 0; --row) {
-            Rune &rune = runeAt(row, col);
-            rune = Rune{};
-            rune.type = randomGem();
-            if (boardGeometryValid_) {
-                const auto center = cellCenter(row, col);
-                rune.currentX = center.first;
-                rune.currentY = gridTop_ + cellHeight_ * 0.5f;
-                rune.positionInitialized = true;
-                rune.targetX = center.first;
-                rune.targetY = center.second;
-            } else {
-                rune.positionInitialized = false;
-            }
-            updateRuneTarget(row, col, rune);
-        }
-    }
+    // the emitters spawn on the next animation step, within their budget
+    scene_.emitters.trigger(spawn,
+                            accumulatedX / static_cast<float>(validCount),
+                            accumulatedY / static_cast<float>(validCount),
+                            validCount,
+                            std::min(cellWidth_, cellHeight_));
 }
 
 bool Renderer::updateBoardState() {
@@ -986,32 +718,21 @@ bool Renderer::updateBoardState() {
         return false;
     }
 
-    if (gameState_ != GameState::PLAYING) {
+    // let the runes of the last step land before showing the next, so every step of a cascade
+    // shows; the worker has the next one ready meanwhile
+    if (runesMoving_) {
         return false;
     }
 
-    return processMatches();
-}
-
-bool Renderer::processMatches() {
-    bool changed = false;
-    while (gameState_ == GameState::PLAYING) {
-        auto matches = findMatches();
-        if (matches.empty()) {
-            break;
-        }
-        applyMatchEffects(matches);
-        removeMatches(matches);
-        applyGravityAndFill();
-        changed = true;
-        if (gameState_ != GameState::PLAYING) {
-            break;
-        }
-    }
-    if (changed) {
-        sceneDirty_ = true;
+    const SessionFrame *frame = worker_.acquireFrame();
+    if (!frame) {
+        return false;
     }
-    return changed;
+    frame_ = frame;
+    scene_.syncVitals(frame->stats);
+    swapInFlight_ = false;
+    applyFrame(*frame);
+    return true;
 }
 
 Model Renderer::buildQuadModel(float left,
@@ -1084,6 +805,63 @@ void Renderer::renderQuad(float left,
                                         texture));
 }
 
+void Renderer::drawActors(float screenWidth,
+                          float screenHeight,
+                          float worldWidth,
+                          float worldHeight) {
+    auto worldRect = [&](const ScreenLayout &layout) {
+        const float widthWorld = layout.widthPx * worldWidth / screenWidth;
+        const float heightWorld = layout.heightPx * worldHeight / screenHeight;
+        const float leftWorld =
+                -worldWidth * 0.5f + (layout.leftPx(screenWidth) / screenWidth) * worldWidth;
+        const float topWorld =
+                kProjectionHalfHeight - (layout.topPx(screenHeight) / screenHeight) * worldHeight;
+        return std::array<float, 4>{leftWorld, topWorld - heightWorld, widthWorld, heightWorld};
+    };
+
+    scene_.combatants.forEach([&](const Portrait &portrait,
+                                  const ScreenLayout &layout,
+                                  const Vitals &) {
+        const auto rect = worldRect(layout);
+        renderTexture(portrait.role == ActorRole::Hero ? spHeroTexture_ : spEnemyTexture_,
+                      rect[0],
+                      rect[1],
+                      rect[2],
+                      rect[3],
+                      0.05f);
+    });
+
+    scene_.widgets.forEach([&](const StatWidget &widget, const ScreenLayout &layout) {
+        const Vitals *vitals = scene_.vitalsOf(widget.owner);
+        if (!vitals) {
+            return;
+        }
+        const auto rect = worldRect(layout);
+        if (widget.kind == WidgetKind::HealthBar) {
+            drawHPBar(vitals->hp, vitals->maxHP, rect[0], rect[1], rect[2], rect[3]);
+            return;
+        }
+        if (vitals->shield <= 0 || vitals->maxShield <= 0) {
+            return;
+        }
+        renderQuad(rect[0], rect[1], rect[2], rect[3], 0.15f, 0.3f, 0.18f, 1.0f, 0.06f);
+        float shieldRatio =
+                static_cast<float>(vitals->shield) / static_cast<float>(vitals->maxShield);
+        shieldRatio = std::clamp(shieldRatio, 0.0f, 1.0f);
+        if (shieldRatio > 0.0f) {
+            renderQuad(rect[0],
+                       rect[1],
+                       rect[2] * shieldRatio,
+                       rect[3],
+                       0.4f,
+                       0.8f,
+                       0.4f,
+                       1.0f,
+                       0.05f);
+        }
+    });
+}
+
 void Renderer::drawHPBar(int hp,
                          int hpMax,
                          float left,
@@ -1160,29 +938,13 @@ std::shared_ptr<TextureAsset> Renderer::textureForGem(GemType type) const {
     }
 }
 
-Renderer::Rune &Renderer::runeAt(int row, int col) {
-    const size_t index = static_cast<size_t>(row * kBoardColumns + col);
-    return board_[index];
-}
-
-const Renderer::Rune &Renderer::runeAt(int row, int col) const {
-    const size_t index = static_cast<size_t>(row * kBoardColumns + col);
-    return board_[index];
-}
-
-void Renderer::updateRuneTarget(int row, int col, Rune &rune) {
-    if (rune.type == GemType::None || !boardGeometryValid_) {
+void Renderer::updateRuneTarget(int index) {
+    if (runeTypes_[index] == GemType::None || !boardGeometryValid_) {
         return;
     }
 
-    const auto center = cellCenter(row, col);
-    rune.targetX = center.first;
-    rune.targetY = center.second;
-    if (!rune.positionInitialized) {
-        rune.currentX = rune.targetX;
-        rune.currentY = rune.targetY;
-        rune.positionInitialized = true;
-    }
+    const auto center = cellCenter(GameBoard::rowOf(index), GameBoard::columnOf(index));
+    runeMotion_.setTarget(index, center.first, center.second);
 }
 
 void Renderer::updateAllRuneTargets(bool snapToTarget) {
@@ -1190,19 +952,14 @@ void Renderer::updateAllRuneTargets(bool snapToTarget) {
         return;
     }
 
-    for (int row = 0; row < kBoardRows; ++row) {
-        for (int col = 0; col < kBoardColumns; ++col) {
-            Rune &rune = runeAt(row, col);
-            if (rune.type == GemType::None) {
-                continue;
-            }
+    for (int index = 0; index < GameBoard::kCells; ++index) {
+        if (runeTypes_[index] == GemType::None) {
+            continue;
+        }
 
-            updateRuneTarget(row, col, rune);
-            if (snapToTarget) {
-                rune.currentX = rune.targetX;
-                rune.currentY = rune.targetY;
-                rune.positionInitialized = true;
-            }
+        updateRuneTarget(index);
+        if (snapToTarget) {
+            runeMotion_.snapToTarget(index);
         }
     }
 }
@@ -1213,56 +970,42 @@ void Renderer::updateRuneAnimation(float deltaTimeSeconds) {
     }
 
     const float safePixelScale = boardPixelToWorld_ <= 0.0f ? 1.0f : boardPixelToWorld_;
-    bool anyMovement = false;
-
-    for (auto &rune: board_) {
-        if (rune.type == GemType::None) {
-            continue;
-        }
-
-        const float deltaX = rune.targetX - rune.currentX;
-        const float deltaY = rune.targetY - rune.currentY;
-        if (std::fabs(deltaX) > 0.0001f || std::fabs(deltaY) > 0.0001f) {
-            anyMovement = true;
-        }
-        rune.currentX += deltaX * 10.0f * deltaTimeSeconds;
-        rune.currentY += deltaY * 10.0f * deltaTimeSeconds;
-
-        const float diffX = std::fabs(rune.currentX - rune.targetX) / safePixelScale;
-        const float diffY = std::fabs(rune.currentY - rune.targetY) / safePixelScale;
-        if (diffX < 1.0f && diffY < 1.0f) {
-            rune.currentX = rune.targetX;
-            rune.currentY = rune.targetY;
-            rune.positionInitialized = true;
-        }
-    }
-
-    if (anyMovement) {
+    // runes within a pixel of their cell snap onto it
+    runesMoving_ = runeMotion_.step(10.0f * deltaTimeSeconds, safePixelScale).any();
+    if (runesMoving_) {
         sceneDirty_ = true;
     }
 }
 
-void Renderer::updateWindEffects(float deltaTimeSeconds) {
-    if (windSwirls_.empty() || deltaTimeSeconds <= 0.0f) {
-        return;
-    }
-
-    for (auto &swirl: windSwirls_) {
-        swirl.life += deltaTimeSeconds;
-        swirl.angle += swirl.angularVelocity * deltaTimeSeconds;
+void Renderer::updateParticles(float deltaTimeSeconds) {
+    // the particles are drawn from the pool every frame, so moving them needs no new models
+    if (deltaTimeSeconds > 0.0f) {
+        scene_.particles.step(deltaTimeSeconds);
+        scene_.emitters.update(deltaTimeSeconds, scene_.particles, rng_);
     }
+}
 
-    bool removed = false;
-    auto it = std::remove_if(windSwirls_.begin(), windSwirls_.end(), [](const WindSwirl &swirl) {
-        return swirl.life >= swirl.maxLife;
-    });
-    if (it != windSwirls_.end()) {
-        windSwirls_.erase(it, windSwirls_.end());
-        removed = true;
+void Renderer::drawParticles() {
+    const ParticlePool &pool = scene_.particles;
+    if (pool.empty() ||
+        particleVertices_.size() < ParticlePool::kCapacity * ParticlePool::kVerticesPerParticle) {
+        return;
     }
-
-    if (!windSwirls_.empty() || removed) {
-        sceneDirty_ = true;
+    // one draw per layer; the vertex buffer is consumed by each draw call, so it is reused
+    for (int layer = 1; layer < kElementSpawnCount; ++layer) {
+        if (!spParticleTextures_[layer]) {
+            continue;
+        }
+        const int quads = pool.emitQuads(particleVertices_.data(),
+                                         kParticleZ,
+                                         static_cast<uint8_t>(layer));
+        if (quads == 0) {
+            continue;
+        }
+        shader_->drawTriangles(particleVertices_.data(),
+                               particleIndices_.data(),
+                               quads * ParticlePool::kIndicesPerParticle,
+                               *spParticleTextures_[layer]);
     }
 }
 
@@ -1334,7 +1077,8 @@ void Renderer::handleInput() {
 }
 
 bool Renderer::attemptSwap(int startRow, int startCol, int endRow, int endCol) {
-    if (!boardReady_ || gameState_ != GameState::PLAYING) {
+    if (!frame_ || frame_->state != GameState::PLAYING || frame_->phase != CascadePhase::Idle ||
+        swapInFlight_) {
         return false;
     }
 
@@ -1346,35 +1090,22 @@ bool Renderer::attemptSwap(int startRow, int startCol, int endRow, int endCol) {
         return false;
     }
 
-    if (startRow == endRow && startCol == endCol) {
-        return false;
-    }
-
-    const int rowDelta = std::abs(startRow - endRow);
-    const int colDelta = std::abs(startCol - endCol);
-    if (!((rowDelta == 1 && colDelta == 0) || (rowDelta == 0 && colDelta == 1))) {
-        return false;
-    }
-
-    Rune &firstRune = runeAt(startRow, startCol);
-    Rune &secondRune = runeAt(endRow, endCol);
-    if (firstRune.type == GemType::None || secondRune.type == GemType::None) {
-        return false;
-    }
-
-    std::swap(firstRune, secondRune);
-    updateRuneTarget(startRow, startCol, firstRune);
-    updateRuneTarget(endRow, endCol, secondRune);
+    const int firstIndex = GameBoard::cellIndex(startRow, startCol);
+    const int secondIndex = GameBoard::cellIndex(endRow, endCol);
+    swapInFlight_ = worker_.submitSwap(firstIndex, secondIndex);
+    return swapInFlight_;
+}
 
-    auto matches = findMatches();
-    if (matches.empty()) {
-        std::swap(firstRune, secondRune);
-        updateRuneTarget(startRow, startCol, firstRune);
-        updateRuneTarget(endRow, endCol, secondRune);
+bool Renderer::findHint(int &fromRow, int &fromCol, int &toRow, int &toCol) const {
+    if (!frame_ || !frame_->hasHint || swapInFlight_) {
         return false;
     }
 
-    processMatches();
+    const GameBoard::Move &move = frame_->hint;
+    fromRow = GameBoard::rowOf(move.from);
+    fromCol = GameBoard::columnOf(move.from);
+    toRow = GameBoard::rowOf(move.to);
+    toCol = GameBoard::columnOf(move.to);
     return true;
 }
 
@@ -1481,14 +1212,14 @@ void Renderer::triggerRuneSelectionEffect(int row, int col) {
         return;
     }
 
-    const Rune &rune = runeAt(row, col);
-    if (rune.type == GemType::None) {
+    const int index = GameBoard::cellIndex(row, col);
+    if (runeTypes_[index] == GemType::None) {
         return;
     }
 
-    float centerWorldX = rune.positionInitialized ? rune.currentX : 0.0f;
-    float centerWorldY = rune.positionInitialized ? rune.currentY : 0.0f;
-    if (!rune.positionInitialized) {
+    float centerWorldX = runeMotion_.x(index);
+    float centerWorldY = runeMotion_.y(index);
+    if (!runeMotion_.placed(index)) {
         const auto center = cellCenter(row, col);
         centerWorldX = center.first;
         centerWorldY = center.second;
@@ -11,7 +11,12 @@
 #include <utility>
 #include <vector>
 
+#include "BattleScene.h"
+#include "BoardEngine.h"
+#include "GameSession.h"
 #include "Model.h"
+#include "RuneAnimation.h"
+#include "SessionWorker.h"
 #include "Shader.h"
 
 class TextureAsset;
@@ -22,8 +27,9 @@ class Renderer {
 public:
     /*!
      * @param pApp the android_app this Renderer belongs to, needed to configure GL
+     * @param heroClass the hero the player picked for new games
      */
-    inline Renderer(android_app *pApp) :
+    inline Renderer(android_app *pApp, HeroClass heroClass) :
             app_(pApp),
             display_(EGL_NO_DISPLAY),
             surface_(EGL_NO_SURFACE),
@@ -31,14 +37,11 @@ public:
             width_(0),
             height_(0),
             shaderNeedsNewProjectionMatrix_(true),
+            heroClass_(heroClass),
+            worker_(std::random_device{}(), balanceFor(heroClass)),
             rng_(std::random_device{}()),
-            gemDistribution_(0, 3),
             sceneDirty_(true),
-            boardReady_(false),
-            heroHP_(heroMaxHP_),
-            enemyHP_(enemyMaxHP_),
-            heroShield_(0),
-            gameState_(GameState::START) {
+            boardReady_(false) {
         initRenderer();
     }
 
@@ -56,6 +59,25 @@ public:
      */
     void render();
 
+    /*!
+     * Suggests a swap the player can make on the current board.
+     * @return false if the board is not in play or has no legal swap
+     */
+    bool findHint(int &fromRow, int &fromCol, int &toRow, int &toCol) const;
+
+    /*!
+     * Captures the game in play so it can be resumed after the window or the process goes away.
+     * @return false if there is no game to capture
+     */
+    bool saveSnapshot(SessionSnapshot &outSnapshot);
+
+    /*!
+     * Replaces the game in play with the one captured in @a snapshot. A resumed game is not
+     * recorded as a replay, since its seed alone no longer reproduces it.
+     * @return false if @a snapshot could not be restored; the current game is kept
+     */
+    bool restoreSnapshot(const SessionSnapshot &snapshot);
+
 private:
     /*!
      * Performs necessary OpenGL initialization. Customize this if you want to change your EGL
@@ -75,46 +97,18 @@ private:
      */
     void createModels();
 
-    enum class GemType {
-        None = -1,
-        Fire = 0,
-        Water = 1,
-        Air = 2,
-        Earth = 3,
-    };
-
-    struct MatchGroup {
-        GemType type;
-        std::vector<std::pair<int, int>> cells;
-    };
-
-    enum class GameState {
-        START,
-        PLAYING,
-        VICTORY,
-        DEFEAT,
-    };
-
-    struct Rune {
-        GemType type = GemType::None;
-        float currentX = 0.0f;
-        float currentY = 0.0f;
-        float targetX = 0.0f;
-        float targetY = 0.0f;
-        bool positionInitialized = false;
-    };
+    typedef GameBoard::Mask BoardMask;
+
+    static BalanceConfig balanceFor(HeroClass heroClass);
 
     void ensureBoardInitialized();
-    GemType randomGem();
-    GemType getGem(int row, int col) const;
-    void setGem(int row, int col, GemType type);
-    std::vector<MatchGroup> findMatches() const;
-    void removeMatches(const std::vector<MatchGroup> &matches);
-    void applyGravityAndFill();
-    void applyMatchEffects(const std::vector<MatchGroup> &matches);
-    void spawnWindEffect(const std::vector<std::pair<int, int>> &cells);
+    void applyFrame(const SessionFrame &frame);
+    void resetRunes(const GameBoard &board);
+    void swapRunes(int firstIndex, int secondIndex);
+    void clearRunes(const BoardMask &cells);
+    void dropRunes(const GameBoard::Gravity &gravity, const GameBoard &board);
+    void spawnElementEffect(ElementSpawn spawn, const BoardMask &cells);
     bool updateBoardState();
-    bool processMatches();
     bool attemptSwap(int startRow, int startCol, int endRow, int endCol);
     bool screenToWorld(float screenX, float screenY, float &worldX, float &worldY) const;
     bool worldToScreen(float worldX, float worldY, float &screenX, float &screenY) const;
@@ -144,6 +138,7 @@ private:
                     float b,
                     float a,
                     float z);
+    void drawActors(float screenWidth, float screenHeight, float worldWidth, float worldHeight);
     void drawHPBar(int hp,
                    int hpMax,
                    float left,
@@ -155,12 +150,11 @@ private:
                                                        float b,
                                                        float a);
     std::shared_ptr<TextureAsset> textureForGem(GemType type) const;
-    Rune &runeAt(int row, int col);
-    const Rune &runeAt(int row, int col) const;
-    void updateRuneTarget(int row, int col, Rune &rune);
+    void updateRuneTarget(int index);
     void updateAllRuneTargets(bool snapToTarget);
     void updateRuneAnimation(float deltaTimeSeconds);
-    void updateWindEffects(float deltaTimeSeconds);
+    void updateParticles(float deltaTimeSeconds);
+    void drawParticles();
     std::pair<float, float> cellCenter(int row, int col) const;
 
     android_app *app_;
@@ -179,26 +173,33 @@ private:
     std::shared_ptr<TextureAsset> spGreenGemTexture_;
     std::shared_ptr<TextureAsset> spBlueGemTexture_;
     std::shared_ptr<TextureAsset> spTurquoiseGemTexture_;
-    std::shared_ptr<TextureAsset> spWindSwirlTexture_;
     std::shared_ptr<TextureAsset> spHeroTexture_;
     std::shared_ptr<TextureAsset> spEnemyTexture_;
     std::shared_ptr<TextureAsset> spWhiteTexture_;
+    std::shared_ptr<TextureAsset> spBombGlowTexture_;
     std::shared_ptr<TextureAsset> spVictoryTexture_;
     std::shared_ptr<TextureAsset> spDefeatTexture_;
     std::unordered_map<uint32_t, std::shared_ptr<TextureAsset>> solidColorTextures_;
-
-    std::vector<Rune> board_;
-    std::mt19937 rng_;
-    std::uniform_int_distribution<int> gemDistribution_;
+    //! the texture of each particle layer, indexed by ElementSpawn
+    std::array<std::shared_ptr<TextureAsset>, kElementSpawnCount> spParticleTextures_;
+
+    //! the gem shown in each cell; where it is drawn lives in runeMotion_
+    std::array<GemType, GameBoard::kCells> runeTypes_;
+    RuneAnimation runeMotion_;
+    //! whether any rune was still on its way at the last animation step
+    bool runesMoving_ = false;
+    HeroClass heroClass_;
+    //! runs the game on its own thread; frame_ is the step on screen
+    SessionWorker worker_;
+    const SessionFrame *frame_ = nullptr;
+    //! the worker's combat events, read up to the frame on screen; they pick each visual effect
+    CombatEventRing::Cursor combatCursor_;
+    //! a swap went to the worker and no frame has come back since
+    bool swapInFlight_ = false;
+    //! drives visual effects only; gameplay randomness belongs to the session
+    Pcg32 rng_;
     bool sceneDirty_;
     bool boardReady_;
-    int heroHP_;
-    int enemyHP_;
-    int heroShield_;
-    const int heroMaxHP_ = 100;
-    const int enemyMaxHP_ = 100;
-    const int heroMaxShield_ = 100;
-    GameState gameState_;
     bool boardGeometryValid_ = false;
     float boardLeft_ = 0.0f;
     float boardRight_ = 0.0f;
@@ -216,19 +217,13 @@ private:
     int selectedCol_ = 0;
     int32_t activePointerId_ = -1;
     std::chrono::steady_clock::time_point lastFrameTime_ = std::chrono::steady_clock::now();
-    struct WindSwirl {
-        float centerX;
-        float centerY;
-        float radius;
-        float angularVelocity;
-        float angle;
-        float life;
-        float maxLife;
-        float baseSize;
-        float pulseFrequency;
-        float radiusGrowth;
-    };
-    std::vector<WindSwirl> windSwirls_;
+    //! the combatants, their stat bars and the effects around the board
+    BattleScene scene_;
+    //! every particle's quad, rewritten each frame; sized for a full pool once
+    std::vector<ParticleVertex> particleVertices_;
+    std::vector<Index> particleIndices_;
+    //! the particles are drawn before models_[particleLayer_], above the board and the runes
+    size_t particleLayer_ = 0;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
@@ -0,0 +1,212 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "BinaryStream.h"
+
+static constexpr uint8_t kReplayMagic[4] = {'R', 'B', 'R', 'P'};
+//! version 2: sessions draw from Pcg32, so version 1 seeds deal different boards
+//! version 3: refill weights follow the balance values; refills take two bits per gem
+//! version 4: special runes, switched by a flag after the refill weights; the outcome's board
+//! carries its runes. Version 3 replays still load and play without runes.
+//! version 5: the flag byte gains a bit for pre-rolled refill queues. Older replays still load
+//! and draw refills on demand.
+//! version 6: the hero class, after the rules byte. Older replays play as the warrior.
+static constexpr uint8_t kReplayVersion = 6;
+//! bits of the rules byte that follows the refill weights
+static constexpr uint8_t kRuleSpecialRunes = 1U << 0;
+static constexpr uint8_t kRulePrerolledRefills = 1U << 1;
+static constexpr uint8_t kOldestReplayVersion = 3;
+
+void Replay::serialize(std::vector<uint8_t> &outBytes) const {
+    outBytes.clear();
+    ByteWriter writer(outBytes);
+    writer.bytes(kReplayMagic, sizeof(kReplayMagic));
+    writer.u8(kReplayVersion);
+    writer.u8(GameBoard::kRows);
+    writer.u8(GameBoard::kColumns);
+    writer.u8(GameBoard::kGemTypes);
+    writer.u32(seed);
+    writer.i16(static_cast<int16_t>(balance.fireMatchDamage));
+    writer.i16(static_cast<int16_t>(balance.waterMatchHeal));
+    writer.i16(static_cast<int16_t>(balance.airMatchDamage));
+    writer.i16(static_cast<int16_t>(balance.earthMatchShield));
+    for (const auto weight: balance.refillWeights) {
+        writer.u16(weight);
+    }
+    writer.u8((balance.specialRunes ? kRuleSpecialRunes : 0) |
+              (balance.prerolledRefills ? kRulePrerolledRefills : 0));
+    writer.u8(static_cast<uint8_t>(balance.heroClass));
+
+    writer.varint(static_cast<uint32_t>(swaps.size()));
+    uint32_t previousTimeMs = 0;
+    for (const auto &swap: swaps) {
+        writer.varint(swap.timeMs - previousTimeMs);
+        writer.u8(swap.from);
+        writer.u8(swap.to);
+        previousTimeMs = swap.timeMs;
+    }
+
+    GameBoard::PackedCells packedBoard;
+    const bool writeOutcome = hasOutcome && finalBoard.pack(packedBoard);
+    writer.u8(writeOutcome ? 1 : 0);
+    if (writeOutcome) {
+        writer.u8(static_cast<uint8_t>(finalState));
+        writer.i16(static_cast<int16_t>(finalStats.heroHP));
+        writer.i16(static_cast<int16_t>(finalStats.enemyHP));
+        writer.i16(static_cast<int16_t>(finalStats.heroShield));
+        writer.bytes(packedBoard.data(), packedBoard.size());
+        GameBoard::PackedSpecials packedSpecials;
+        finalBoard.packSpecials(packedSpecials);
+        writer.bytes(packedSpecials.data(), packedSpecials.size());
+    }
+}
+
+bool Replay::deserialize(const uint8_t *data, size_t size, Replay &outReplay) {
+    ByteReader reader(data, size);
+    uint8_t magic[sizeof(kReplayMagic)];
+    reader.bytes(magic, sizeof(magic));
+    if (!std::equal(std::begin(magic), std::end(magic), std::begin(kReplayMagic))) {
+        return false;
+    }
+    const uint8_t version = reader.u8();
+    if (version < kOldestReplayVersion || version > kReplayVersion ||
+        reader.u8() != GameBoard::kRows ||
+        reader.u8() != GameBoard::kColumns ||
+        reader.u8() != GameBoard::kGemTypes) {
+        return false;
+    }
+
+    Replay replay;
+    replay.seed = reader.u32();
+    replay.balance.fireMatchDamage = reader.i16();
+    replay.balance.waterMatchHeal = reader.i16();
+    replay.balance.airMatchDamage = reader.i16();
+    replay.balance.earthMatchShield = reader.i16();
+    for (auto &weight: replay.balance.refillWeights) {
+        weight = reader.u16();
+    }
+    const uint8_t rules = version >= 4 ? reader.u8() : 0;
+    replay.balance.specialRunes = (rules & kRuleSpecialRunes) != 0;
+    replay.balance.prerolledRefills = version >= 5 && (rules & kRulePrerolledRefills) != 0;
+    const uint8_t heroClass = version >= 6 ? reader.u8() : 0;
+    if (heroClass >= kHeroClassCount) {
+        return false;
+    }
+    replay.balance.heroClass = static_cast<HeroClass>(heroClass);
+
+    const uint32_t swapCount = reader.varint();
+    // every swap takes at least three bytes, which bounds the reservation for corrupt counts
+    if (!reader.ok() || swapCount > size / 3) {
+        return false;
+    }
+    replay.swaps.resize(swapCount);
+    uint32_t timeMs = 0;
+    for (auto &swap: replay.swaps) {
+        timeMs += reader.varint();
+        swap.timeMs = timeMs;
+        swap.from = reader.u8();
+        swap.to = reader.u8();
+    }
+
+    replay.hasOutcome = reader.u8() != 0;
+    if (replay.hasOutcome) {
+        const uint8_t state = reader.u8();
+        if (state > static_cast<uint8_t>(GameState::DEFEAT)) {
+            return false;
+        }
+        replay.finalState = static_cast<GameState>(state);
+        replay.finalStats.heroHP = reader.i16();
+        replay.finalStats.enemyHP = reader.i16();
+        replay.finalStats.heroShield = reader.i16();
+        GameBoard::PackedCells packedBoard;
+        reader.bytes(packedBoard.data(), packedBoard.size());
+        if (!replay.finalBoard.unpack(packedBoard)) {
+            return false;
+        }
+        if (version >= 4) {
+            GameBoard::PackedSpecials packedSpecials;
+            reader.bytes(packedSpecials.data(), packedSpecials.size());
+            if (!replay.finalBoard.unpackSpecials(packedSpecials)) {
+                return false;
+            }
+        }
+    }
+
+    if (!reader.ok() || !reader.atEnd()) {
+        return false;
+    }
+    outReplay = std::move(replay);
+    return true;
+}
+
+bool Replay::save(const std::string &path) const {
+    std::vector<uint8_t> bytes;
+    serialize(bytes);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(bytes.data()),
+               static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+bool Replay::load(const std::string &path, Replay &outReplay) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                                     std::istreambuf_iterator<char>());
+    return deserialize(bytes.data(), bytes.size(), outReplay);
+}
+
+void ReplayRecorder::begin(uint32_t seed, const BalanceConfig &balance) {
+    replay_ = Replay{};
+    replay_.seed = seed;
+    replay_.balance = balance;
+    replay_.swaps.reserve(256);
+    start_ = std::chrono::steady_clock::now();
+}
+
+void ReplayRecorder::recordSwap(int from, int to) {
+    ReplaySwap swap;
+    swap.timeMs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+    swap.from = static_cast<uint8_t>(from);
+    swap.to = static_cast<uint8_t>(to);
+    replay_.swaps.push_back(swap);
+}
+
+void ReplayRecorder::finish(const GameSession &session) {
+    replay_.hasOutcome = true;
+    replay_.finalState = session.state();
+    replay_.finalStats = session.stats();
+    replay_.finalBoard = session.board();
+}
+
+ReplayCheck playReplay(const Replay &replay, SessionProfile *profile) {
+    GameSession session(replay.seed, replay.balance);
+    session.setProfile(profile);
+    session.start();
+
+    ReplayCheck check;
+    for (const auto &swap: replay.swaps) {
+        if (session.attemptSwap(swap.from, swap.to)) {
+            ++check.swapsApplied;
+        } else {
+            ++check.swapsRejected;
+        }
+    }
+
+    if (replay.hasOutcome) {
+        const CombatStats &stats = session.stats();
+        check.boardMatches = session.board() == replay.finalBoard;
+        check.statsMatch = session.state() == replay.finalState &&
+                           stats.heroHP == replay.finalStats.heroHP &&
+                           stats.enemyHP == replay.finalStats.enemyHP &&
+                           stats.heroShield == replay.finalStats.heroShield;
+        check.matches = check.boardMatches && check.statsMatch;
+    }
+    return check;
+}
@@ -0,0 +1,93 @@
+#ifndef ANDROIDGLINVESTIGATIONS_REPLAY_H
+#define ANDROIDGLINVESTIGATIONS_REPLAY_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GameSession.h"
+
+/*!
+ * One swap the player attempted, legal or not, with the time since the session started.
+ */
+struct ReplaySwap {
+    uint32_t timeMs = 0;
+    uint8_t from = 0;
+    uint8_t to = 0;
+};
+
+/*!
+ * Everything needed to play a session again: the seed, the balance it was played with and every
+ * swap attempt in order. A replay may also carry the state the session ended in, which playback
+ * checks against.
+ *
+ * The binary form is little-endian: the magic "RBRP", a version byte, the board shape, the seed,
+ * the balance values, a varint swap count and per swap a varint time delta in milliseconds plus
+ * the two cell indices, then an optional outcome holding the game state, the combat stats and
+ * the final board at two bits per gem and three per special rune.
+ */
+struct Replay {
+    uint32_t seed = 0;
+    BalanceConfig balance;
+    std::vector<ReplaySwap> swaps;
+
+    bool hasOutcome = false;
+    GameState finalState = GameState::START;
+    CombatStats finalStats;
+    GameBoard finalBoard;
+
+    void serialize(std::vector<uint8_t> &outBytes) const;
+
+    /*!
+     * @return false if @a data is not a replay of this build's board shape
+     */
+    static bool deserialize(const uint8_t *data, size_t size, Replay &outReplay);
+
+    bool save(const std::string &path) const;
+
+    static bool load(const std::string &path, Replay &outReplay);
+};
+
+/*!
+ * Collects a replay while a session is played. Hook @a recordSwap into the input path before the
+ * swap is handed to the session.
+ */
+class ReplayRecorder {
+public:
+    void begin(uint32_t seed, const BalanceConfig &balance);
+
+    void recordSwap(int from, int to);
+
+    /*!
+     * Stores the session's current state as the outcome playback must reach.
+     */
+    void finish(const GameSession &session);
+
+    inline const Replay &replay() const { return replay_; }
+
+private:
+    Replay replay_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/*!
+ * The result of playing a replay back.
+ */
+struct ReplayCheck {
+    int swapsApplied = 0;
+    int swapsRejected = 0;
+    //! true if the replay has no outcome or the session ended exactly in it
+    bool matches = true;
+    bool boardMatches = true;
+    bool statsMatch = true;
+};
+
+/*!
+ * Starts a session with the replay's seed and balance, plays every recorded swap into it without
+ * waiting between swaps and compares the end state with the recorded outcome.
+ * @param profile receives the session's stage timings if not null
+ */
+ReplayCheck playReplay(const Replay &replay, SessionProfile *profile = nullptr);
+
+#endif //ANDROIDGLINVESTIGATIONS_REPLAY_H
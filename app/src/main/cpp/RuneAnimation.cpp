@@ -0,0 +1,167 @@
+#include "RuneAnimation.h"
+
+#include <cmath>
+#include <utility>
+
+#include "Simd.h"
+
+//! a rune closer than this to its target on both axes is not moving
+static constexpr float kMovementEpsilon = 0.0001f;
+
+void RuneAnimation::clear() {
+    currentX_.fill(0.0f);
+    currentY_.fill(0.0f);
+    targetX_.fill(0.0f);
+    targetY_.fill(0.0f);
+    placed_ = Mask{};
+}
+
+void RuneAnimation::reset(int index) {
+    currentX_[index] = 0.0f;
+    currentY_[index] = 0.0f;
+    targetX_[index] = 0.0f;
+    targetY_[index] = 0.0f;
+    placed_.reset(index);
+}
+
+void RuneAnimation::setTarget(int index, float x, float y) {
+    targetX_[index] = x;
+    targetY_[index] = y;
+    if (!placed_.test(index)) {
+        snapToTarget(index);
+    }
+}
+
+void RuneAnimation::place(int index, float x, float y) {
+    currentX_[index] = x;
+    currentY_[index] = y;
+    placed_.set(index);
+}
+
+void RuneAnimation::snapToTarget(int index) {
+    currentX_[index] = targetX_[index];
+    currentY_[index] = targetY_[index];
+    placed_.set(index);
+}
+
+void RuneAnimation::swap(int first, int second) {
+    std::swap(currentX_[first], currentX_[second]);
+    std::swap(currentY_[first], currentY_[second]);
+    std::swap(targetX_[first], targetX_[second]);
+    std::swap(targetY_[first], targetY_[second]);
+    const bool firstPlaced = placed_.test(first);
+    const bool secondPlaced = placed_.test(second);
+    secondPlaced ? placed_.set(first) : placed_.reset(first);
+    firstPlaced ? placed_.set(second) : placed_.reset(second);
+}
+
+void RuneAnimation::move(int from, int to) {
+    currentX_[to] = currentX_[from];
+    currentY_[to] = currentY_[from];
+    targetX_[to] = targetX_[from];
+    targetY_[to] = targetY_[from];
+    placed_.test(from) ? placed_.set(to) : placed_.reset(to);
+    reset(from);
+}
+
+void RuneAnimation::fall(const GameBoard::Gravity &gravity, float rowOffsetY) {
+    // bottom up, so every rune is read before another one lands on it
+    for (int index = GameBoard::kCells - 1; index >= 0; --index) {
+        if (!gravity.moved.test(index)) {
+            continue;
+        }
+        const int rows = gravity.fallRows[index];
+        const int from = index - rows * GameBoard::kColumns;
+        currentX_[index] = currentX_[from];
+        currentY_[index] = currentY_[from];
+        targetX_[index] = targetX_[from];
+        targetY_[index] = targetY_[from] + static_cast<float>(rows) * rowOffsetY;
+        placed_.test(from) ? placed_.set(index) : placed_.reset(index);
+    }
+    gravity.refilled.forEach([this](int index) {
+        reset(index);
+    });
+}
+
+RuneAnimation::Mask RuneAnimation::step(float blend, float snapDistance) {
+#if RUNEBOUND_SIMD_NEON
+    Mask moving{};
+    const float32x4_t blendVector = vdupq_n_f32(blend);
+    const float32x4_t snapVector = vdupq_n_f32(snapDistance);
+    const float32x4_t epsilonVector = vdupq_n_f32(kMovementEpsilon);
+    for (int i = 0; i < kSlots; i += kLanes) {
+        float32x4_t x = vld1q_f32(&currentX_[i]);
+        float32x4_t y = vld1q_f32(&currentY_[i]);
+        const float32x4_t tx = vld1q_f32(&targetX_[i]);
+        const float32x4_t ty = vld1q_f32(&targetY_[i]);
+
+        const float32x4_t dx = vsubq_f32(tx, x);
+        const float32x4_t dy = vsubq_f32(ty, y);
+        const uint32x4_t away = vorrq_u32(vcgtq_f32(vabsq_f32(dx), epsilonVector),
+                                          vcgtq_f32(vabsq_f32(dy), epsilonVector));
+        x = vaddq_f32(x, vmulq_f32(dx, blendVector));
+        y = vaddq_f32(y, vmulq_f32(dy, blendVector));
+
+        const uint32x4_t arrived = vandq_u32(vcltq_f32(vabsq_f32(vsubq_f32(x, tx)), snapVector),
+                                             vcltq_f32(vabsq_f32(vsubq_f32(y, ty)), snapVector));
+        vst1q_f32(&currentX_[i], vbslq_f32(arrived, tx, x));
+        vst1q_f32(&currentY_[i], vbslq_f32(arrived, ty, y));
+
+        const uint64_t bits = simd::laneMask(away);
+        moving.words[i >> 6] |= bits << (i & 63);
+    }
+    return moving;
+#elif RUNEBOUND_SIMD_SSE
+    Mask moving{};
+    const __m128 blendVector = _mm_set1_ps(blend);
+    const __m128 snapVector = _mm_set1_ps(snapDistance);
+    const __m128 epsilonVector = _mm_set1_ps(kMovementEpsilon);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    for (int i = 0; i < kSlots; i += kLanes) {
+        __m128 x = _mm_load_ps(&currentX_[i]);
+        __m128 y = _mm_load_ps(&currentY_[i]);
+        const __m128 tx = _mm_load_ps(&targetX_[i]);
+        const __m128 ty = _mm_load_ps(&targetY_[i]);
+
+        const __m128 dx = _mm_sub_ps(tx, x);
+        const __m128 dy = _mm_sub_ps(ty, y);
+        const __m128 away = _mm_or_ps(_mm_cmpgt_ps(_mm_andnot_ps(signBit, dx), epsilonVector),
+                                      _mm_cmpgt_ps(_mm_andnot_ps(signBit, dy), epsilonVector));
+        x = _mm_add_ps(x, _mm_mul_ps(dx, blendVector));
+        y = _mm_add_ps(y, _mm_mul_ps(dy, blendVector));
+
+        const __m128 arrived = _mm_and_ps(
+                _mm_cmplt_ps(_mm_andnot_ps(signBit, _mm_sub_ps(x, tx)), snapVector),
+                _mm_cmplt_ps(_mm_andnot_ps(signBit, _mm_sub_ps(y, ty)), snapVector));
+        _mm_store_ps(&currentX_[i], _mm_or_ps(_mm_and_ps(arrived, tx), _mm_andnot_ps(arrived, x)));
+        _mm_store_ps(&currentY_[i], _mm_or_ps(_mm_and_ps(arrived, ty), _mm_andnot_ps(arrived, y)));
+
+        const uint64_t bits = simd::laneMask(away);
+        moving.words[i >> 6] |= bits << (i & 63);
+    }
+    return moving;
+#else
+    return stepScalar(blend, snapDistance);
+#endif
+}
+
+RuneAnimation::Mask RuneAnimation::stepScalar(float blend, float snapDistance) {
+    Mask moving{};
+    for (int i = 0; i < kSlots; ++i) {
+        const float dx = targetX_[i] - currentX_[i];
+        const float dy = targetY_[i] - currentY_[i];
+        if (std::fabs(dx) > kMovementEpsilon || std::fabs(dy) > kMovementEpsilon) {
+            moving.words[i >> 6] |= uint64_t{1} << (i & 63);
+        }
+        const float stepX = dx * blend;
+        const float stepY = dy * blend;
+        currentX_[i] += stepX;
+        currentY_[i] += stepY;
+        if (std::fabs(currentX_[i] - targetX_[i]) < snapDistance &&
+            std::fabs(currentY_[i] - targetY_[i]) < snapDistance) {
+            currentX_[i] = targetX_[i];
+            currentY_[i] = targetY_[i];
+        }
+    }
+    return moving;
+}
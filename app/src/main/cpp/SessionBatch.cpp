@@ -0,0 +1,346 @@
+#include "SessionBatch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#include "Simd.h"
+
+namespace {
+
+constexpr int kColumns = GameBoard::kColumns;
+constexpr int kGemTypes = GameBoard::kGemTypes;
+
+// Two lanes' masks side by side. Shift counts are template arguments because both instruction
+// sets only shift whole vectors by immediates.
+#if RUNEBOUND_SIMD_NEON
+typedef uint64x2_t LanePair;
+
+inline LanePair loadPair(const uint64_t *words) { return vld1q_u64(words); }
+
+inline void storePair(uint64_t *words, LanePair pair) { vst1q_u64(words, pair); }
+
+inline LanePair broadcast(uint64_t word) { return vdupq_n_u64(word); }
+
+inline LanePair bitAnd(LanePair a, LanePair b) { return vandq_u64(a, b); }
+
+inline LanePair bitOr(LanePair a, LanePair b) { return vorrq_u64(a, b); }
+
+//! @a a with the bits of @a b cleared
+inline LanePair bitAndNot(LanePair a, LanePair b) { return vbicq_u64(a, b); }
+
+template<int Bits>
+inline LanePair shiftRight(LanePair pair) { return vshrq_n_u64(pair, Bits); }
+
+template<int Bits>
+inline LanePair shiftLeft(LanePair pair) { return vshlq_n_u64(pair, Bits); }
+
+inline bool isZero(LanePair pair) { return vmaxvq_u32(vreinterpretq_u32_u64(pair)) == 0; }
+#elif RUNEBOUND_SIMD_SSE
+typedef __m128i LanePair;
+
+inline LanePair loadPair(const uint64_t *words) {
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(words));
+}
+
+inline void storePair(uint64_t *words, LanePair pair) {
+    _mm_store_si128(reinterpret_cast<__m128i *>(words), pair);
+}
+
+inline LanePair broadcast(uint64_t word) { return _mm_set1_epi64x(static_cast<long long>(word)); }
+
+inline LanePair bitAnd(LanePair a, LanePair b) { return _mm_and_si128(a, b); }
+
+inline LanePair bitOr(LanePair a, LanePair b) { return _mm_or_si128(a, b); }
+
+//! @a a with the bits of @a b cleared
+inline LanePair bitAndNot(LanePair a, LanePair b) { return _mm_andnot_si128(b, a); }
+
+template<int Bits>
+inline LanePair shiftRight(LanePair pair) { return _mm_srli_epi64(pair, Bits); }
+
+template<int Bits>
+inline LanePair shiftLeft(LanePair pair) { return _mm_slli_epi64(pair, Bits); }
+
+inline bool isZero(LanePair pair) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(pair, _mm_setzero_si128())) == 0xFFFF;
+}
+#else
+struct LanePair {
+    uint64_t first;
+    uint64_t second;
+};
+
+inline LanePair loadPair(const uint64_t *words) { return {words[0], words[1]}; }
+
+inline void storePair(uint64_t *words, LanePair pair) {
+    words[0] = pair.first;
+    words[1] = pair.second;
+}
+
+inline LanePair broadcast(uint64_t word) { return {word, word}; }
+
+inline LanePair bitAnd(LanePair a, LanePair b) { return {a.first & b.first, a.second & b.second}; }
+
+inline LanePair bitOr(LanePair a, LanePair b) { return {a.first | b.first, a.second | b.second}; }
+
+//! @a a with the bits of @a b cleared
+inline LanePair bitAndNot(LanePair a, LanePair b) {
+    return {a.first & ~b.first, a.second & ~b.second};
+}
+
+template<int Bits>
+inline LanePair shiftRight(LanePair pair) { return {pair.first >> Bits, pair.second >> Bits}; }
+
+template<int Bits>
+inline LanePair shiftLeft(LanePair pair) { return {pair.first << Bits, pair.second << Bits}; }
+
+inline bool isZero(LanePair pair) { return (pair.first | pair.second) == 0; }
+#endif
+
+inline const bitboard::BoardTables<GameBoard::kRows, kColumns> &tables() {
+    return bitboard::kBoardTables<GameBoard::kRows, kColumns>;
+}
+
+} // namespace
+
+SessionBatch::SessionBatch(const BalanceConfig &balance) :
+        balance_(balance),
+        effects_(balance.effects()) {
+    assert(!balance_.specialRunes && "batched lanes play without special runes");
+    refillSampler_.setWeights(balance_.refillWeights);
+}
+
+void SessionBatch::start(int lane, uint32_t seed) {
+    rng_[lane] = Pcg32(seed);
+    refillBits_[lane] = RandomBits{};
+    GameBoard board;
+    board.generate(rng_[lane], GameSession::kMinInitialLegalMoves);
+    storeBoard(lane, board);
+    refillQueues_[lane].clear();
+    if (balance_.prerolledRefills) {
+        refillQueues_[lane].topUp(refillSampler_, rng_[lane], refillBits_[lane]);
+    }
+
+    const CombatStats stats;
+    heroHP_[lane] = stats.heroHP;
+    enemyHP_[lane] = stats.enemyHP;
+    heroShield_[lane] = stats.heroShield;
+    cascadeLength_[lane] = 0;
+    state_[lane] = GameState::PLAYING;
+}
+
+SessionBatch::LaneMask SessionBatch::attemptSwaps(LaneMask lanes, const Moves &moves) {
+    LaneMask swapped = 0;
+    GameBoard board;
+    for (LaneMask pending = lanes; pending; pending &= pending - 1) {
+        const int lane = __builtin_ctz(pending);
+        const int first = moves[lane].from;
+        const int second = moves[lane].to;
+        if (state_[lane] != GameState::PLAYING ||
+            first >= GameBoard::kCells || second >= GameBoard::kCells ||
+            std::abs(GameBoard::rowOf(first) - GameBoard::rowOf(second)) +
+            std::abs(GameBoard::columnOf(first) - GameBoard::columnOf(second)) != 1) {
+            continue;
+        }
+        loadBoard(lane, board);
+        if (!board.isLegalSwap(first, second)) {
+            continue;
+        }
+        // both gem types lose one of the cells and gain the other
+        const uint64_t swapBits = (uint64_t{1} << first) | (uint64_t{1} << second);
+        gems_[static_cast<int>(board.at(first))][lane] ^= swapBits;
+        gems_[static_cast<int>(board.at(second))][lane] ^= swapBits;
+        cascadeLength_[lane] = 0;
+        swapped |= LaneMask{1} << lane;
+    }
+
+    LaneMask resolving = swapped;
+    alignas(16) LaneWords cleared;
+    while (resolving != 0) {
+        findMatches(resolving, cleared);
+        for (LaneMask pending = resolving; pending; pending &= pending - 1) {
+            const int lane = __builtin_ctz(pending);
+            if (cleared[lane] != 0) {
+                continue;
+            }
+            resolving &= ~(LaneMask{1} << lane);
+            if (cascadeLength_[lane] > 0 && state_[lane] == GameState::PLAYING) {
+                ensurePlayableBoard(lane);
+            }
+        }
+        if (resolving == 0) {
+            break;
+        }
+
+        applyMatchEffects(cleared);
+        clearAndFall(cleared);
+        for (LaneMask pending = resolving; pending; pending &= pending - 1) {
+            const int lane = __builtin_ctz(pending);
+            refill(lane);
+            ++cascadeLength_[lane];
+            // the step that ends the battle still clears and refills, then nothing more resolves
+            if (state_[lane] != GameState::PLAYING) {
+                resolving &= ~(LaneMask{1} << lane);
+            }
+        }
+    }
+    return swapped;
+}
+
+SessionBatch::LaneMask SessionBatch::playing() const {
+    LaneMask lanes = 0;
+    for (int lane = 0; lane < kLanes; ++lane) {
+        if (state_[lane] == GameState::PLAYING) {
+            lanes |= LaneMask{1} << lane;
+        }
+    }
+    return lanes;
+}
+
+void SessionBatch::loadBoard(int lane, GameBoard &outBoard) const {
+    std::array<GameBoard::Mask, kGemTypes> gems;
+    for (int type = 0; type < kGemTypes; ++type) {
+        gems[type].words[0] = gems_[type][lane];
+    }
+    outBoard.assign(gems);
+}
+
+CombatStats SessionBatch::stats(int lane) const {
+    CombatStats stats;
+    stats.heroHP = heroHP_[lane];
+    stats.enemyHP = enemyHP_[lane];
+    stats.heroShield = heroShield_[lane];
+    return stats;
+}
+
+void SessionBatch::findMatches(LaneMask lanes, LaneWords &outCleared) const {
+    alignas(16) LaneWords laneBits;
+    for (int lane = 0; lane < kLanes; ++lane) {
+        laneBits[lane] = (lanes >> lane) & 1 ? ~uint64_t{0} : 0;
+    }
+
+    // the same row and column run tests as GameBoard::findMatches, on two lanes at a time
+    const LanePair runStarts = broadcast(tables().horizontalRunStarts.words[0]);
+    for (int lane = 0; lane < kLanes; lane += 2) {
+        LanePair cleared = broadcast(0);
+        bitboard::staticFor<kGemTypes>([&](auto type) {
+            const LanePair gems = loadPair(&gems_[type][lane]);
+            const LanePair rowStarts = bitAnd(bitAnd(gems, shiftRight<1>(gems)),
+                                              bitAnd(shiftRight<2>(gems), runStarts));
+            const LanePair columnStarts = bitAnd(gems, bitAnd(shiftRight<kColumns>(gems),
+                                                              shiftRight<2 * kColumns>(gems)));
+            cleared = bitOr(cleared, bitOr(rowStarts, bitOr(shiftLeft<1>(rowStarts),
+                                                            shiftLeft<2>(rowStarts))));
+            cleared = bitOr(cleared, bitOr(columnStarts,
+                                           bitOr(shiftLeft<kColumns>(columnStarts),
+                                                 shiftLeft<2 * kColumns>(columnStarts))));
+        });
+        storePair(&outCleared[lane], bitAnd(cleared, loadPair(&laneBits[lane])));
+    }
+}
+
+void SessionBatch::applyMatchEffects(const LaneWords &cleared) {
+    // lanes without matches come out unchanged, so every lane takes the same path
+    for (int lane = 0; lane < kLanes; ++lane) {
+        int32_t damage = 0;
+        int32_t heal = 0;
+        int32_t shield = 0;
+        for (int type = 0; type < kGemTypes; ++type) {
+            const int32_t count = __builtin_popcountll(cleared[lane] & gems_[type][lane]);
+            damage += count * effects_.damage[type];
+            heal += count * effects_.heal[type];
+            shield += count * effects_.shield[type];
+        }
+        enemyHP_[lane] = std::max(0, enemyHP_[lane] - damage);
+        heroHP_[lane] = std::min(CombatStats::kHeroMaxHP, heroHP_[lane] + heal);
+        heroShield_[lane] = std::min(CombatStats::kHeroMaxShield, heroShield_[lane] + shield);
+    }
+
+    for (int lane = 0; lane < kLanes; ++lane) {
+        if (state_[lane] != GameState::PLAYING) {
+            continue;
+        }
+        if (enemyHP_[lane] <= 0) {
+            state_[lane] = GameState::VICTORY;
+        } else if (heroHP_[lane] <= 0) {
+            state_[lane] = GameState::DEFEAT;
+        }
+    }
+}
+
+void SessionBatch::clearAndFall(const LaneWords &cleared) {
+    const LanePair full = broadcast(tables().full.words[0]);
+    for (int lane = 0; lane < kLanes; lane += 2) {
+        const LanePair clearedPair = loadPair(&cleared[lane]);
+        LanePair gems[kGemTypes];
+        LanePair occupied = broadcast(0);
+        bitboard::staticFor<kGemTypes>([&](auto type) {
+            gems[type] = bitAndNot(loadPair(&gems_[type][lane]), clearedPair);
+            occupied = bitOr(occupied, gems[type]);
+        });
+
+        // every gem with a gap right below it drops one row per pass; a column settles within
+        // Rows - 1 passes
+        for (int pass = 1; pass < GameBoard::kRows; ++pass) {
+            const LanePair falling =
+                    bitAnd(occupied, shiftRight<kColumns>(bitAndNot(full, occupied)));
+            if (isZero(falling)) {
+                break;
+            }
+            bitboard::staticFor<kGemTypes>([&](auto type) {
+                const LanePair moving = bitAnd(gems[type], falling);
+                gems[type] = bitOr(bitAndNot(gems[type], falling), shiftLeft<kColumns>(moving));
+            });
+            occupied = bitOr(bitAndNot(occupied, falling), shiftLeft<kColumns>(falling));
+        }
+
+        bitboard::staticFor<kGemTypes>([&](auto type) {
+            storePair(&gems_[type][lane], gems[type]);
+        });
+    }
+}
+
+void SessionBatch::refill(int lane) {
+    uint64_t occupied = 0;
+    for (int type = 0; type < kGemTypes; ++type) {
+        occupied |= gems_[type][lane];
+    }
+    const uint64_t gaps = tables().full.words[0] & ~occupied;
+    if (gaps == 0) {
+        return;
+    }
+    // the draw order of GameBoard::applyGravityAndFill: columns left to right, bottom-most first
+    for (int col = 0; col < kColumns; ++col) {
+        for (uint64_t columnGaps = gaps & tables().columns[col].words[0]; columnGaps;) {
+            const int index = 63 - __builtin_clzll(columnGaps);
+            const int type = balance_.prerolledRefills
+                             ? static_cast<int>(refillQueues_[lane].pop(col))
+                             : refillSampler_(rng_[lane], refillBits_[lane]);
+            gems_[type][lane] |= uint64_t{1} << index;
+            columnGaps &= ~(uint64_t{1} << index);
+        }
+    }
+    if (balance_.prerolledRefills) {
+        refillQueues_[lane].topUp(refillSampler_, rng_[lane], refillBits_[lane]);
+    }
+}
+
+void SessionBatch::ensurePlayableBoard(int lane) {
+    GameBoard board;
+    loadBoard(lane, board);
+    if (board.hasLegalMove()) {
+        return;
+    }
+    if (!board.reshuffle(rng_[lane])) {
+        // no arrangement of the remaining gems is playable, deal a new board instead
+        board.generate(rng_[lane], GameSession::kMinInitialLegalMoves);
+    }
+    storeBoard(lane, board);
+}
+
+void SessionBatch::storeBoard(int lane, const GameBoard &board) {
+    for (int type = 0; type < kGemTypes; ++type) {
+        gems_[type][lane] = board.gems(static_cast<GemType>(type)).words[0];
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SESSIONBATCH_H
+#define ANDROIDGLINVESTIGATIONS_SESSIONBATCH_H
+
+#include <array>
+#include <cstdint>
+
+#include "GameSession.h"
+#include "Random.h"
+
+/*!
+ * Up to @a kLanes independent sessions on the game board, stored transposed: one array per gem
+ * type holding that type's cell mask for every lane. Match scans, clears and gravity run over all
+ * lanes at once, two lanes per vector step (NEON on arm64, SSE2 on x86, a plain loop anywhere
+ * else), and the effects of a cascade step are summed for every lane in the same pass. Lanes that
+ * settle, finish their battle or were not asked to move drop out of the cascade through a lane
+ * mask while the rest carry on.
+ *
+ * Every lane plays by the rules of @a GameSession with special runes off: the same seed and the
+ * same swaps give the same boards, stats and cascade lengths, which runebound-balance --check
+ * verifies turn by turn. Dealing, reshuffling and refill draws (or queue pops and top-ups) stay
+ * scalar per lane, since they consume each lane's own random stream in order.
+ */
+class SessionBatch {
+public:
+    static constexpr int kLanes = 16;
+
+    //! bit i stands for lane i
+    typedef uint32_t LaneMask;
+    typedef std::array<GameBoard::Move, kLanes> Moves;
+
+    static_assert(GameBoard::kCells <= 64, "a lane keeps each gem type in one 64-bit word");
+    static_assert(kLanes % 2 == 0 && kLanes <= 32, "lanes go two to a vector and fit a LaneMask");
+
+    /*!
+     * @param balance the match effect values every lane plays with; special runes must be off
+     */
+    explicit SessionBatch(const BalanceConfig &balance);
+
+    /*!
+     * Deals @a lane a fresh board and resets both its combatants, as GameSession(seed, balance)
+     * followed by @a GameSession::start would.
+     */
+    void start(int lane, uint32_t seed);
+
+    /*!
+     * Tries the swap in @a moves for every lane in @a lanes that is playing and resolves the
+     * cascades of all the swaps made together. A refused swap leaves its lane untouched.
+     * @return the lanes whose swap was legal and applied
+     */
+    LaneMask attemptSwaps(LaneMask lanes, const Moves &moves);
+
+    //! the lanes that were started and whose battle is not over yet
+    LaneMask playing() const;
+
+    //! copies @a lane's board into @a outBoard, with every line marked dirty
+    void loadBoard(int lane, GameBoard &outBoard) const;
+
+    CombatStats stats(int lane) const;
+
+    inline GameState state(int lane) const { return state_[lane]; }
+
+    //! cascade steps the last applied swap of @a lane resolved
+    inline int lastCascadeLength(int lane) const { return cascadeLength_[lane]; }
+
+private:
+    typedef std::array<uint64_t, kLanes> LaneWords;
+
+    //! the cells in a run of three or more, per lane; lanes outside @a lanes get none
+    void findMatches(LaneMask lanes, LaneWords &outCleared) const;
+
+    //! the same sums over the effect table and clamps as @a CombatStats::applyMatches, then the
+    //! battle outcome
+    void applyMatchEffects(const LaneWords &cleared);
+
+    //! empties @a cleared and lets every gem above a gap fall to the bottom of its column
+    void clearAndFall(const LaneWords &cleared);
+
+    //! fills the gaps at the top of @a lane's columns from its refill queues or stream
+    void refill(int lane);
+
+    //! reshuffles, or deals anew, a settled board of @a lane that has no legal swap left
+    void ensurePlayableBoard(int lane);
+
+    void storeBoard(int lane, const GameBoard &board);
+
+    BalanceConfig balance_;
+    ElementEffectTable effects_;
+    AliasSampler<GameBoard::kGemTypes> refillSampler_;
+
+    alignas(16) std::array<LaneWords, GameBoard::kGemTypes> gems_{};
+    alignas(16) std::array<int32_t, kLanes> heroHP_{};
+    alignas(16) std::array<int32_t, kLanes> enemyHP_{};
+    alignas(16) std::array<int32_t, kLanes> heroShield_{};
+    std::array<GameState, kLanes> state_{};
+    std::array<int, kLanes> cascadeLength_{};
+    std::array<Pcg32, kLanes> rng_;
+    std::array<RandomBits, kLanes> refillBits_{};
+    std::array<GameRefillQueues, kLanes> refillQueues_{};
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SESSIONBATCH_H
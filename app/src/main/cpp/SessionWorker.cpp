@@ -0,0 +1,203 @@
+#include "SessionWorker.h"
+
+#include <cassert>
+
+void SessionFrame::clearChanges() {
+    reset = false;
+    swapFirst = kNoSwap;
+    swapSecond = kNoSwap;
+    matchedByType = {};
+    cleared = GameBoard::Mask{};
+    formedSpecials = GameBoard::Mask{};
+    gravity = GameBoard::Gravity{};
+    statsChanged = false;
+    deltaCount = 0;
+}
+
+SessionWorker::SessionWorker(uint32_t seed, const BalanceConfig &balance) :
+        session_(seed, balance) {
+    session_.setListener(this);
+    session_.setDeltaLog(&deltas_);
+    session_.setCombatEvents(&combatEvents_);
+    session_.setStepwiseCascades(true);
+}
+
+SessionWorker::~SessionWorker() {
+    stop();
+    if (!replaySaved_) {
+        // the recorded outcome is a settled board, as playback produces
+        session_.processMatches();
+        recorder_.finish(session_);
+        recorder_.replay().save(replayPath_);
+    }
+}
+
+GameSession &SessionWorker::session() {
+    assert(!isRunning() && "the session belongs to the worker thread while it runs");
+    return session_;
+}
+
+void SessionWorker::recordReplay(const std::string &path) {
+    assert(!isRunning());
+    replayPath_ = path;
+    replaySaved_ = path.empty();
+    if (!path.empty()) {
+        recorder_.begin(session_.seed(), session_.balance());
+    }
+}
+
+void SessionWorker::start() {
+    if (isRunning()) {
+        return;
+    }
+    pending_.clearChanges();
+    pending_.reset = true;
+    // whatever was done while stopped is summed up by a fresh reset
+    frameDeltas_ = deltas_.nextSequence();
+    deltas_.appendReset(session_.board(), session_.stats(), session_.state());
+    publishPending_ = true;
+    stopping_.store(false, std::memory_order_relaxed);
+    thread_ = std::thread(&SessionWorker::run, this);
+}
+
+void SessionWorker::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    stopping_.store(true, std::memory_order_relaxed);
+    wake();
+    thread_.join();
+    // swaps nobody will get to would otherwise land on whatever board the next start brings
+    swaps_.clear();
+}
+
+bool SessionWorker::submitSwap(int firstIndex, int secondIndex) {
+    if (firstIndex < 0 || firstIndex >= GameBoard::kCells ||
+        secondIndex < 0 || secondIndex >= GameBoard::kCells) {
+        return false;
+    }
+    GameBoard::Move move;
+    move.from = static_cast<uint8_t>(firstIndex);
+    move.to = static_cast<uint8_t>(secondIndex);
+    if (!swaps_.push(move)) {
+        return false;
+    }
+    wake();
+    return true;
+}
+
+const SessionFrame *SessionWorker::acquireFrame() {
+    const uint64_t published = published_.load(std::memory_order_acquire);
+    if (published == acquired_.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    acquired_.store(published, std::memory_order_release);
+    wake();
+    return &frames_[published & 1];
+}
+
+void SessionWorker::wake() {
+    {
+        // taking the lock orders the change before the worker's next look at hasWork
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+    }
+    wake_.notify_one();
+}
+
+bool SessionWorker::hasWork() const {
+    // frame published_ + 1 goes where the render thread's previous frame was, so it may only be
+    // written once the render thread has moved on to the newest one
+    if (acquired_.load(std::memory_order_acquire) != published_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    return publishPending_ || session_.isResolving() || !swaps_.empty();
+}
+
+void SessionWorker::run() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wake_.wait(lock, [this]() {
+                return stopping_.load(std::memory_order_relaxed) || hasWork();
+            });
+            if (stopping_.load(std::memory_order_relaxed)) {
+                return;
+            }
+        }
+
+        if (publishPending_) {
+            publishPending_ = false;
+        } else if (session_.isResolving()) {
+            session_.stepCascade();
+        } else {
+            GameBoard::Move move;
+            swaps_.pop(move);
+            if (session_.state() != GameState::PLAYING) {
+                continue;
+            }
+            if (!replaySaved_) {
+                recorder_.recordSwap(move.from, move.to);
+            }
+            // a refused swap still gets a frame, so the render thread knows it was handled
+            session_.attemptSwap(move.from, move.to);
+        }
+        publish();
+
+        if (!replaySaved_ && session_.state() != GameState::PLAYING && !session_.isResolving()) {
+            recorder_.finish(session_);
+            recorder_.replay().save(replayPath_);
+            replaySaved_ = true;
+        }
+    }
+}
+
+void SessionWorker::publish() {
+    const uint64_t sequence = published_.load(std::memory_order_relaxed) + 1;
+    SessionFrame &frame = frames_[sequence & 1];
+    frame = pending_;
+    frame.sequence = sequence;
+    frame.board = session_.board();
+    frame.stats = session_.stats();
+    frame.state = session_.state();
+    frame.phase = session_.cascadePhase();
+    frame.hasHint = session_.findHint(frame.hint);
+    const bool complete = deltas_.forEachSince(frameDeltas_, [&frame](const BoardDelta &delta) {
+        assert(frame.deltaCount < SessionFrame::kMaxDeltas);
+        frame.deltas[frame.deltaCount++] = delta;
+    });
+    assert(complete && "a step emitted more deltas than the log holds");
+    (void) complete;
+    frameDeltas_ = deltas_.nextSequence();
+    frame.combatEventEnd = combatEvents_.nextSequence();
+    pending_.clearChanges();
+    published_.store(sequence, std::memory_order_release);
+}
+
+void SessionWorker::onBoardReset() {
+    pending_.reset = true;
+}
+
+void SessionWorker::onGemsSwapped(int firstIndex, int secondIndex) {
+    pending_.swapFirst = firstIndex;
+    pending_.swapSecond = secondIndex;
+}
+
+void SessionWorker::onMatchesResolved(const GameBoard::MatchResult &matches) {
+    pending_.matchedByType = matches.clearedByType;
+}
+
+void SessionWorker::onGemsCleared(const GameBoard::Mask &cells) {
+    pending_.cleared = cells;
+}
+
+void SessionWorker::onSpecialRuneFormed(int index, SpecialRune) {
+    pending_.formedSpecials.set(index);
+}
+
+void SessionWorker::onGemsFell(const GameBoard::Gravity &gravity) {
+    pending_.gravity = gravity;
+}
+
+void SessionWorker::onStatsChanged() {
+    pending_.statsChanged = true;
+}
@@ -0,0 +1,182 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SESSIONWORKER_H
+#define ANDROIDGLINVESTIGATIONS_SESSIONWORKER_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "BoardDelta.h"
+#include "CombatEvents.h"
+#include "GameSession.h"
+#include "Replay.h"
+#include "SpscQueue.h"
+
+/*!
+ * The state of a @a GameSession after one step, with the changes that step made in the order a
+ * listener would have seen them: a board reset, a swap, the runs scored, the cells cleared, the
+ * gems that fell and the cells that were refilled. A frame is immutable once published.
+ *
+ * The same step also comes as the session's deltas, which continue the previous frame's
+ * sequence; consumers that only follow deltas never need to look at the other fields.
+ */
+struct SessionFrame {
+    static constexpr int kNoSwap = -1;
+    //! no single step emits more than a reset does
+    static constexpr int kMaxDeltas = BoardDeltaLog::kResetDeltas;
+
+    uint64_t sequence = 0;
+    GameBoard board;
+    CombatStats stats;
+    GameState state = GameState::START;
+    CascadePhase phase = CascadePhase::Idle;
+
+    //! the whole board changed; the other changes are already folded into @a board
+    bool reset = false;
+    int swapFirst = kNoSwap;
+    int swapSecond = kNoSwap;
+    std::array<GameBoard::Mask, GameBoard::kGemTypes> matchedByType{};
+    GameBoard::Mask cleared{};
+    //! gems that turned into special runes after the clear
+    GameBoard::Mask formedSpecials{};
+    //! how far the gems fell and which cells were refilled
+    GameBoard::Gravity gravity;
+    bool statsChanged = false;
+    std::array<BoardDelta, kMaxDeltas> deltas{};
+    int deltaCount = 0;
+    //! combat events before this sequence happened by the end of this step
+    uint32_t combatEventEnd = 0;
+
+    //! a legal swap on a settled board in play
+    bool hasHint = false;
+    GameBoard::Move hint;
+
+    inline bool hasSwap() const { return swapFirst != kNoSwap; }
+
+    inline bool hasMatches() const {
+        for (const auto &cells: matchedByType) {
+            if (cells.any()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! forgets the changes, keeping the state
+    void clearChanges();
+};
+
+/*!
+ * Runs a @a GameSession on its own thread. The render thread queues swaps without locking and
+ * picks up the session's steps as double-buffered @a SessionFrame s, one step per frame: the
+ * worker prepares the next step while the current one is drawn, and never writes the frame the
+ * render thread holds.
+ *
+ * Cascades are resolved stepwise and the worker does not run ahead of the render thread by more
+ * than one frame, so the render thread paces the cascade, for instance by taking the next frame
+ * only once the last refill has landed.
+ */
+class SessionWorker : private GameSessionListener {
+public:
+    //! swaps waiting beyond this many are refused
+    static constexpr size_t kSwapQueueCapacity = 16;
+
+    explicit SessionWorker(uint32_t seed, const BalanceConfig &balance = BalanceConfig{});
+
+    /*!
+     * Stops the thread, settles the board and saves the replay if one is being recorded and the
+     * battle did not end.
+     */
+    ~SessionWorker() override;
+
+    SessionWorker(const SessionWorker &) = delete;
+
+    SessionWorker &operator=(const SessionWorker &) = delete;
+
+    /*!
+     * The session itself, for starting, restoring or saving it. Only valid while stopped.
+     */
+    GameSession &session();
+
+    /*!
+     * Records the session's swaps from now on and writes the replay to @a path when the battle
+     * ends. An empty path stops recording, as for a resumed session. Only valid while stopped.
+     */
+    void recordReplay(const std::string &path);
+
+    /*!
+     * Starts the thread. Its first frame resets the board, so whatever was done to the session
+     * while stopped shows up.
+     */
+    void start();
+
+    //! finishes the current step and joins the thread
+    void stop();
+
+    inline bool isRunning() const { return thread_.joinable(); }
+
+    /*!
+     * Queues a swap from the render thread. The worker ignores it if the board is not settled
+     * and in play by the time it gets to it.
+     * @return false if the queue is full
+     */
+    bool submitSwap(int firstIndex, int secondIndex);
+
+    /*!
+     * Takes the next frame, if the worker has published one since the last call. The frame stays
+     * valid and unchanged until the next successful call; the previous one is handed back to the
+     * worker. Render thread only.
+     */
+    const SessionFrame *acquireFrame();
+
+    /*!
+     * Every combat event of the session, for any thread to poll at its own pace. Polling up to a
+     * frame's @a SessionFrame::combatEventEnd keeps events in step with the frames drawn.
+     */
+    inline const CombatEventRing &combatEvents() const { return combatEvents_; }
+
+private:
+    void run();
+    bool hasWork() const;
+    void publish();
+    void wake();
+
+    void onBoardReset() override;
+    void onGemsSwapped(int firstIndex, int secondIndex) override;
+    void onMatchesResolved(const GameBoard::MatchResult &matches) override;
+    void onGemsCleared(const GameBoard::Mask &cells) override;
+    void onSpecialRuneFormed(int index, SpecialRune special) override;
+    void onGemsFell(const GameBoard::Gravity &gravity) override;
+    void onStatsChanged() override;
+
+    GameSession session_;
+    //! the changes of the step in progress; only the worker touches it while running
+    SessionFrame pending_;
+    std::array<SessionFrame, 2> frames_;
+    //! sequence of the newest published frame; frame n lives in frames_[n & 1]
+    std::atomic<uint64_t> published_{0};
+    //! sequence of the frame the render thread holds
+    std::atomic<uint64_t> acquired_{0};
+    //! the next frame goes out even without a step, as after @a start
+    bool publishPending_ = false;
+    SpscQueue<GameBoard::Move, kSwapQueueCapacity> swaps_;
+    BoardDeltaLog deltas_;
+    //! the first delta the next frame carries
+    uint32_t frameDeltas_ = 0;
+    CombatEventRing combatEvents_;
+
+    ReplayRecorder recorder_;
+    std::string replayPath_;
+    bool replaySaved_ = true;
+
+    std::thread thread_;
+    //! only for sleeping; the frames and the swap queue never lock
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> stopping_{false};
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SESSIONWORKER_H
@@ -116,6 +116,16 @@ void Shader::deactivate() const {
 }
 
 void Shader::drawModel(const Model &model) const {
+    drawTriangles(model.getVertexData(),
+                  model.getIndexData(),
+                  static_cast<GLsizei>(model.getIndexCount()),
+                  model.getTexture());
+}
+
+void Shader::drawTriangles(const void *vertices,
+                           const uint16_t *indices,
+                           GLsizei indexCount,
+                           const TextureAsset &texture) const {
     // The position attribute is 3 floats
     glVertexAttribPointer(
             position_, // attrib
@@ -123,7 +133,7 @@ void Shader::drawModel(const Model &model) const {
             GL_FLOAT, // of type float
             GL_FALSE, // don't normalize
             sizeof(Vertex), // stride is Vertex bytes
-            model.getVertexData() // pull from the start of the vertex data
+            vertices // pull from the start of the vertex data
     );
     glEnableVertexAttribArray(position_);
 
@@ -134,16 +144,16 @@ void Shader::drawModel(const Model &model) const {
             GL_FLOAT, // of type float
             GL_FALSE, // don't normalize
             sizeof(Vertex), // stride is Vertex bytes
-            ((uint8_t *) model.getVertexData()) + sizeof(Vector3) // offset Vector3 from the start
+            ((const uint8_t *) vertices) + sizeof(Vector3) // offset Vector3 from the start
     );
     glEnableVertexAttribArray(uv_);
 
     // Setup the texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID());
+    glBindTexture(GL_TEXTURE_2D, texture.getTextureID());
 
     // Draw as indexed triangles
-    glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, indices);
 
     glDisableVertexAttribArray(uv_);
     glDisableVertexAttribArray(position_);
@@ -1,11 +1,14 @@
 #ifndef ANDROIDGLINVESTIGATIONS_SHADER_H
 #define ANDROIDGLINVESTIGATIONS_SHADER_H
 
+#include <cstdint>
 #include <string>
 #include <GLES3/gl3.h>
 
 class Model;
 
+class TextureAsset;
+
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
  * input attributes are a position (as a Vector3) and a uv (as a Vector2). It also takes a uniform
@@ -57,6 +60,18 @@ public:
      */
     void drawModel(const Model &model) const;
 
+    /*!
+     * Renders indexed triangles straight from memory the caller keeps, for geometry rebuilt every
+     * frame that should not become a Model
+     * @param vertices interleaved position and uv, laid out as a Vertex
+     * @param indices @a indexCount indices into @a vertices
+     * @param texture the texture to sample
+     */
+    void drawTriangles(const void *vertices,
+                       const uint16_t *indices,
+                       GLsizei indexCount,
+                       const TextureAsset &texture) const;
+
     /*!
      * Sets the model/view/projection matrix in the shader.
      * @param projectionMatrix sixteen floats, column major, defining an OpenGL projection matrix.
@@ -0,0 +1,41 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SIMD_H
+#define ANDROIDGLINVESTIGATIONS_SIMD_H
+
+#include <cstdint>
+
+// The instruction set the hand-vectorized loops are written for: NEON on arm64, SSE2 on x86. At
+// most one of RUNEBOUND_SIMD_NEON and RUNEBOUND_SIMD_SSE is defined; with neither, those loops run
+// their scalar versions instead.
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RUNEBOUND_SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RUNEBOUND_SIMD_SSE 1
+#endif
+
+namespace simd {
+
+#if RUNEBOUND_SIMD_NEON
+
+/*!
+ * One bit per lane of a four-lane comparison result, lane 0 lowest. NEON has no movemask, so each
+ * lane keeps a bit of its own and the lanes are added up.
+ */
+inline uint32_t laneMask(uint32x4_t lanes) {
+    static constexpr uint32_t kLaneBits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(lanes, vld1q_u32(kLaneBits)));
+}
+
+#elif RUNEBOUND_SIMD_SSE
+
+//! one bit per lane of a four-lane comparison result, lane 0 lowest
+inline uint32_t laneMask(__m128 lanes) {
+    return static_cast<uint32_t>(_mm_movemask_ps(lanes));
+}
+
+#endif
+
+} // namespace simd
+
+#endif //ANDROIDGLINVESTIGATIONS_SIMD_H
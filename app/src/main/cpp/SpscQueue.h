@@ -0,0 +1,58 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SPSCQUEUE_H
+#define ANDROIDGLINVESTIGATIONS_SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/*!
+ * A bounded queue for exactly one producer thread and one consumer thread. Neither side ever
+ * blocks or locks: each owns one index and only reads the other's, so a push or pop is a couple
+ * of loads and one release store.
+ */
+template<typename T, size_t Capacity>
+class SpscQueue {
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "the capacity must be a power of two so indices wrap with a mask");
+
+    //! producer only; @return false if the queue is full
+    bool push(const T &value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! consumer only; @return false if the queue is empty
+    bool pop(T &outValue) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        outValue = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! consumer only
+    bool empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+
+    //! consumer only; drops everything queued so far
+    void clear() {
+        head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::array<T, Capacity> slots_{};
+    // each index is written by one side only; keep them on separate cache lines
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SPSCQUEUE_H
@@ -0,0 +1,88 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+    }
+    workers_.reserve(static_cast<size_t>(threadCount - 1));
+    for (int thread = 1; thread < threadCount; ++thread) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker: workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)> &job) {
+    if (count <= 0) {
+        return;
+    }
+    if (workers_.empty() || count == 1) {
+        for (int index = 0; index < count; ++index) {
+            job(index, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        jobCount_ = count;
+        nextIndex_.store(0, std::memory_order_relaxed);
+        busyWorkers_ = static_cast<int>(workers_.size());
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    runJobs(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() {
+        return busyWorkers_ == 0;
+    });
+    job_ = nullptr;
+}
+
+void ThreadPool::workerLoop(int thread) {
+    uint64_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() {
+                return stopping_ || generation_ != seenGeneration;
+            });
+            if (stopping_) {
+                return;
+            }
+            seenGeneration = generation_;
+        }
+
+        runJobs(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busyWorkers_;
+        }
+        done_.notify_one();
+    }
+}
+
+void ThreadPool::runJobs(int thread) {
+    for (;;) {
+        const int index = nextIndex_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= jobCount_) {
+            return;
+        }
+        (*job_)(index, thread);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef ANDROIDGLINVESTIGATIONS_THREADPOOL_H
+#define ANDROIDGLINVESTIGATIONS_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * A fixed set of worker threads for fork-join work. The workers are started once and sleep
+ * between jobs, so handing out a job costs a wake-up rather than a thread launch.
+ */
+class ThreadPool {
+public:
+    /*!
+     * @param threadCount how many threads run a job, including the caller of @a parallelFor.
+     *     0 uses one per hardware thread.
+     */
+    explicit ThreadPool(int threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    inline int threadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+    /*!
+     * Runs @a job(index) for every index in [0, @a count) spread over the pool and the calling
+     * thread, and returns once all of them have finished. Calls must not overlap.
+     * @param job receives the index and the number of the thread running it, in
+     *     [0, @a threadCount); the calling thread is 0
+     */
+    void parallelFor(int count, const std::function<void(int index, int thread)> &job);
+
+private:
+    void workerLoop(int thread);
+    void runJobs(int thread);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int, int)> *job_ = nullptr;
+    int jobCount_ = 0;
+    std::atomic<int> nextIndex_{0};
+    int busyWorkers_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_THREADPOOL_H
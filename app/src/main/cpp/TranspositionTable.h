@@ -0,0 +1,117 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TRANSPOSITIONTABLE_H
+#define ANDROIDGLINVESTIGATIONS_TRANSPOSITIONTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/*!
+ * A fixed-size hash table of searched position values that any number of threads may probe and
+ * store into without locks.
+ *
+ * Each slot holds two 64-bit words: the packed entry and the entry XORed with its position key.
+ * A reader only accepts a slot whose words XOR back to the key it is looking for, so a slot torn
+ * by two simultaneous writers fails the check and reads as a miss instead of returning a value
+ * that belongs to another position.
+ */
+class TranspositionTable {
+public:
+    /*!
+     * @param entryCount rounded down to a power of two
+     */
+    explicit TranspositionTable(size_t entryCount) {
+        size_t capacity = 1;
+        while (capacity * 2 <= entryCount) {
+            capacity *= 2;
+        }
+        entries_.reset(new Slot[capacity]);
+        mask_ = capacity - 1;
+    }
+
+    /*!
+     * Makes every stored entry stale. Entries carry the age they were stored in and only entries
+     * of the current age are returned, so this is O(1) except once every @a kAgeMask searches,
+     * when the age wraps and the table is wiped so that entries that old never pass as current.
+     * No thread may probe or store meanwhile.
+     */
+    inline void newSearch() {
+        age_ = (age_ + 1) & kAgeMask;
+        if (age_ == 0) {
+            for (size_t i = 0; i <= mask_; ++i) {
+                entries_[i].check.store(0, std::memory_order_relaxed);
+                entries_[i].data.store(0, std::memory_order_relaxed);
+            }
+            age_ = 1;
+        }
+    }
+
+    /*!
+     * @return true if @a key was stored this search at @a depth or deeper, with its value in
+     *     @a outValue
+     */
+    inline bool probe(uint64_t key, int depth, float &outValue) const {
+        const Slot &slot = entries_[key & mask_];
+        const uint64_t data = slot.data.load(std::memory_order_relaxed);
+        const uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || ageOf(data) != age_ || depthOf(data) < depth) {
+            return false;
+        }
+        outValue = valueOf(data);
+        return true;
+    }
+
+    /*!
+     * Stores a value, replacing the slot's entry unless it holds the same position searched
+     * deeper during this search.
+     */
+    inline void store(uint64_t key, int depth, float value) {
+        Slot &slot = entries_[key & mask_];
+        const uint64_t oldData = slot.data.load(std::memory_order_relaxed);
+        const uint64_t oldCheck = slot.check.load(std::memory_order_relaxed);
+        if ((oldCheck ^ oldData) == key && ageOf(oldData) == age_ && depthOf(oldData) > depth) {
+            return;
+        }
+        const uint64_t data = pack(depth, value);
+        slot.data.store(data, std::memory_order_relaxed);
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    //! ages count up in 24 bits, which a search a second takes half a year to wrap
+    static constexpr uint32_t kAgeMask = 0xFFFFFF;
+
+    // data layout: value bits 63..32, age 31..8, depth 7..0
+    inline uint64_t pack(int depth, float value) const {
+        uint32_t valueBits;
+        std::memcpy(&valueBits, &value, sizeof(valueBits));
+        return uint64_t{valueBits} << 32 | uint64_t{age_} << 8 | static_cast<uint8_t>(depth);
+    }
+
+    static inline int depthOf(uint64_t data) {
+        return static_cast<int>(data & 0xFF);
+    }
+
+    static inline uint32_t ageOf(uint64_t data) {
+        return static_cast<uint32_t>(data >> 8) & kAgeMask;
+    }
+
+    static inline float valueOf(uint64_t data) {
+        const uint32_t valueBits = static_cast<uint32_t>(data >> 32);
+        float value;
+        std::memcpy(&value, &valueBits, sizeof(value));
+        return value;
+    }
+
+    std::unique_ptr<Slot[]> entries_;
+    size_t mask_ = 0;
+    //! starts at 1, and skips 0 when it wraps, so zero-filled slots never match the current age
+    uint32_t age_ = 1;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TRANSPOSITIONTABLE_H
@@ -1,5 +1,9 @@
 #include <jni.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
 #include "AndroidOut.h"
 #include "Renderer.h"
 
@@ -10,6 +14,43 @@ extern "C" {
 
 #include <game-activity/native_app_glue/android_native_app_glue.c>
 
+//! the game to resume when the next window comes up, kept across window and activity restarts
+static SessionSnapshot savedSession;
+static bool hasSavedSession = false;
+//! the hero savedSession was played with
+static HeroClass savedSessionHero = HeroClass::Warrior;
+//! set from the UI thread by MainActivity before the game thread starts
+static std::atomic<int> selectedHeroClass{static_cast<int>(HeroClass::Warrior)};
+
+static HeroClass selectedHero() {
+    return static_cast<HeroClass>(selectedHeroClass.load(std::memory_order_acquire));
+}
+
+/*!
+ * Called by MainActivity with the HeroClass ordinal the player picked in the lobby.
+ */
+JNIEXPORT void JNICALL
+Java_com_example_runeboundmagic_MainActivity_nativeSetHeroClass(JNIEnv *,
+                                                                jobject,
+                                                                jint heroClass) {
+    if (heroClass >= 0 && heroClass < kHeroClassCount) {
+        selectedHeroClass.store(heroClass, std::memory_order_release);
+    }
+}
+
+/*!
+ * Captures the renderer's game in @a savedSession, if there is one to capture.
+ */
+static void snapshotSession(android_app *pApp) {
+    if (pApp->userData) {
+        auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+        if (pRenderer->saveSnapshot(savedSession)) {
+            hasSavedSession = true;
+            savedSessionHero = selectedHero();
+        }
+    }
+}
+
 /*!
  * Handles commands sent to this Android application
  * @param pApp the app the commands are coming from
@@ -22,7 +63,11 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
             // "game" class if that suits your needs. Remember to change all instances of userData
             // if you change the class here as a reinterpret_cast is dangerous this in the
             // android_main function and the APP_CMD_TERM_WINDOW handler case.
-            pApp->userData = new Renderer(pApp);
+            pApp->userData = new Renderer(pApp, selectedHero());
+            // a game saved with another hero belongs to a battle the player has left
+            if (hasSavedSession && savedSessionHero == selectedHero()) {
+                reinterpret_cast<Renderer *>(pApp->userData)->restoreSnapshot(savedSession);
+            }
             break;
         case APP_CMD_TERM_WINDOW:
             // The window is being destroyed. Use this to clean up your userData to avoid leaking
@@ -30,12 +75,26 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
             //
             // We have to check if userData is assigned just in case this comes in really quickly
             if (pApp->userData) {
-                //
+                snapshotSession(pApp);
                 auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
                 pApp->userData = nullptr;
                 delete pRenderer;
             }
             break;
+        case APP_CMD_PAUSE:
+            snapshotSession(pApp);
+            break;
+        case APP_CMD_SAVE_STATE:
+            // The glue hands savedState to the system and frees it, so it must come from malloc.
+            snapshotSession(pApp);
+            if (hasSavedSession) {
+                pApp->savedState = malloc(savedSession.bytes.size());
+                if (pApp->savedState) {
+                    memcpy(pApp->savedState, savedSession.bytes.data(), savedSession.bytes.size());
+                    pApp->savedStateSize = savedSession.bytes.size();
+                }
+            }
+            break;
         default:
             break;
     }
@@ -63,6 +122,14 @@ void android_main(struct android_app *pApp) {
     // Can be removed, useful to ensure your code is running
     aout << "Welcome to android_main" << std::endl;
 
+    // The glue frees savedState once the activity resumes, which is before the window comes up
+    if (pApp->savedState && pApp->savedStateSize == savedSession.bytes.size()) {
+        memcpy(savedSession.bytes.data(), pApp->savedState, savedSession.bytes.size());
+        hasSavedSession = true;
+        // the recreated activity carries the same hero as the one the state was saved from
+        savedSessionHero = selectedHero();
+    }
+
     // Register an event handler for Android events
     pApp->onAppCmd = handle_cmd;
 
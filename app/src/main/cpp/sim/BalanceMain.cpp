@@ -0,0 +1,490 @@
+/*!
+ * runebound-balance: Monte Carlo sweep over match effect values. Every configuration plays the
+ * same seeded games with a random player, spread over all cores, and the tool reports win rate,
+ * turns to victory and how long cascades run.
+ *
+ *   runebound-balance [--games N] [--threads T] [--seed S] [--max-turns M]
+ *                     [--config FIRE,WATER,AIR,EARTH]... [--sweep STAT=FROM:TO:STEP]
+ *                     [--refill FIRE,WATER,AIR,EARTH] [--hero CLASS] [--no-specials]
+ *                     [--batch] [--check]
+ *
+ * --config adds one configuration and may be repeated. --sweep adds a configuration for every
+ * value of one stat (fire, water, air or earth), taking the other stats from the first --config
+ * or the shipped defaults. Game g of every configuration is seeded with S + g, so all
+ * configurations start from the same boards and the results do not depend on the thread count.
+ * --refill sets the relative odds of each gem type in refills for every configuration.
+ * --hero plays every configuration as warrior (the default), mage, ranger or priestess.
+ * --no-specials plays without special runes. --batch implies it and plays @a
+ * SessionBatch::kLanes games at a time in lockstep through @a SessionBatch.
+ * --check implies --batch and also plays every game through its own GameSession, comparing board,
+ * stats, state and cascade length after every turn.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "GameSession.h"
+#include "RandomPlayer.h"
+#include "SessionBatch.h"
+
+//! cascades of this many steps or more share the last histogram bucket
+static constexpr int kCascadeBuckets = 8;
+
+struct BalanceOptions {
+    int games = 100000;
+    int threads = 0;
+    uint32_t seed = 1;
+    int maxTurns = 500;
+    bool specialRunes = true;
+    HeroClass heroClass = HeroClass::Warrior;
+    bool batch = false;
+    bool check = false;
+    std::vector<BalanceConfig> configs;
+};
+
+/*!
+ * What one worker learns about one configuration. Workers never touch each other's results; they
+ * are merged once all threads have joined.
+ */
+struct alignas(64) BalanceResult {
+    int games = 0;
+    int victories = 0;
+    int defeats = 0;
+    uint64_t victoryTurns = 0;
+    uint64_t turns = 0;
+    uint64_t cascadeSteps = 0;
+    int longestCascade = 0;
+    //! turns on which a batched lane and its scalar twin disagreed, with --check
+    uint64_t mismatches = 0;
+    //! victories by the turn they were won on, index 0 to maxTurns
+    std::vector<uint32_t> victoryTurnHistogram;
+    //! resolved turns by cascade length, index 0 for turns that cleared nothing
+    std::array<uint64_t, kCascadeBuckets + 1> cascadeHistogram{};
+
+    explicit BalanceResult(int maxTurns) : victoryTurnHistogram(maxTurns + 1, 0) {}
+
+    void merge(const BalanceResult &other) {
+        games += other.games;
+        victories += other.victories;
+        defeats += other.defeats;
+        victoryTurns += other.victoryTurns;
+        turns += other.turns;
+        cascadeSteps += other.cascadeSteps;
+        longestCascade = std::max(longestCascade, other.longestCascade);
+        mismatches += other.mismatches;
+        for (size_t i = 0; i < victoryTurnHistogram.size(); ++i) {
+            victoryTurnHistogram[i] += other.victoryTurnHistogram[i];
+        }
+        for (size_t i = 0; i < cascadeHistogram.size(); ++i) {
+            cascadeHistogram[i] += other.cascadeHistogram[i];
+        }
+    }
+
+    /*!
+     * @return the smallest turn count that at least @a fraction of all victories were won within
+     */
+    int victoryTurnPercentile(double fraction) const {
+        const uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(victories));
+        uint64_t accumulated = 0;
+        for (size_t turn = 0; turn < victoryTurnHistogram.size(); ++turn) {
+            accumulated += victoryTurnHistogram[turn];
+            if (accumulated > 0 && accumulated >= target) {
+                return static_cast<int>(turn);
+            }
+        }
+        return 0;
+    }
+};
+
+static void printUsage() {
+    std::fprintf(stderr,
+                 "usage: runebound-balance [--games N] [--threads T] [--seed S] [--max-turns M]\n"
+                 "                         [--config FIRE,WATER,AIR,EARTH]..."
+                 " [--sweep STAT=FROM:TO:STEP]\n"
+                 "                         [--refill FIRE,WATER,AIR,EARTH] [--hero CLASS]"
+                 " [--no-specials]\n"
+                 "                         [--batch] [--check]\n");
+}
+
+static bool parseConfig(const char *text, BalanceConfig &outConfig) {
+    return std::sscanf(text, "%d,%d,%d,%d",
+                       &outConfig.fireMatchDamage,
+                       &outConfig.waterMatchHeal,
+                       &outConfig.airMatchDamage,
+                       &outConfig.earthMatchShield) == 4;
+}
+
+static bool parseSweep(const char *text,
+                       const BalanceConfig &base,
+                       std::vector<BalanceConfig> &outConfigs) {
+    char stat[16] = {};
+    int from = 0;
+    int to = 0;
+    int step = 1;
+    if (std::sscanf(text, "%15[a-z]=%d:%d:%d", stat, &from, &to, &step) < 3 || step <= 0) {
+        return false;
+    }
+
+    int BalanceConfig::*field;
+    if (std::strcmp(stat, "fire") == 0) {
+        field = &BalanceConfig::fireMatchDamage;
+    } else if (std::strcmp(stat, "water") == 0) {
+        field = &BalanceConfig::waterMatchHeal;
+    } else if (std::strcmp(stat, "air") == 0) {
+        field = &BalanceConfig::airMatchDamage;
+    } else if (std::strcmp(stat, "earth") == 0) {
+        field = &BalanceConfig::earthMatchShield;
+    } else {
+        return false;
+    }
+
+    for (int value = from; value <= to; value += step) {
+        BalanceConfig config = base;
+        config.*field = value;
+        outConfigs.push_back(config);
+    }
+    return true;
+}
+
+static bool parseRefillWeights(const char *text, BalanceConfig::RefillWeights &outWeights) {
+    static_assert(GameBoard::kGemTypes == 4, "--refill takes one weight per gem type");
+    unsigned weights[GameBoard::kGemTypes];
+    if (std::sscanf(text, "%u,%u,%u,%u", &weights[0], &weights[1], &weights[2], &weights[3]) != 4) {
+        return false;
+    }
+    unsigned total = 0;
+    for (size_t i = 0; i < outWeights.size(); ++i) {
+        if (weights[i] > 0xFFFF) {
+            return false;
+        }
+        outWeights[i] = static_cast<uint16_t>(weights[i]);
+        total += weights[i];
+    }
+    return total > 0;
+}
+
+static bool parseOptions(int argc, char **argv, BalanceOptions &options) {
+    std::vector<const char *> sweeps;
+    BalanceConfig::RefillWeights refillWeights = BalanceConfig::equalWeights();
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--games") == 0 && hasValue) {
+            options.games = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(arg, "--max-turns") == 0 && hasValue) {
+            options.maxTurns = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--config") == 0 && hasValue) {
+            BalanceConfig config;
+            if (!parseConfig(argv[++i], config)) {
+                return false;
+            }
+            options.configs.push_back(config);
+        } else if (std::strcmp(arg, "--sweep") == 0 && hasValue) {
+            sweeps.push_back(argv[++i]);
+        } else if (std::strcmp(arg, "--refill") == 0 && hasValue) {
+            if (!parseRefillWeights(argv[++i], refillWeights)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--hero") == 0 && hasValue) {
+            if (!parseHeroClass(argv[++i], options.heroClass)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--no-specials") == 0) {
+            options.specialRunes = false;
+        } else if (std::strcmp(arg, "--batch") == 0) {
+            options.batch = true;
+        } else if (std::strcmp(arg, "--check") == 0) {
+            options.batch = true;
+            options.check = true;
+        } else {
+            return false;
+        }
+    }
+
+    const BalanceConfig base = options.configs.empty() ? BalanceConfig{} : options.configs.front();
+    for (const char *sweep: sweeps) {
+        if (!parseSweep(sweep, base, options.configs)) {
+            return false;
+        }
+    }
+    if (options.configs.empty()) {
+        options.configs.push_back(BalanceConfig{});
+    }
+    if (options.batch) {
+        options.specialRunes = false;
+    }
+    for (auto &config: options.configs) {
+        config.refillWeights = refillWeights;
+        config.specialRunes = options.specialRunes;
+        config.heroClass = options.heroClass;
+    }
+
+    if (options.threads <= 0) {
+        options.threads = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+    }
+    return options.games > 0 && options.maxTurns > 0;
+}
+
+//! counts one resolved turn of @a cascade steps into @a result
+static void recordTurn(int cascade, BalanceResult &result) {
+    result.cascadeSteps += static_cast<uint64_t>(cascade);
+    result.longestCascade = std::max(result.longestCascade, cascade);
+    ++result.cascadeHistogram[std::min(cascade, kCascadeBuckets)];
+}
+
+//! counts a game that ended in @a state after @a turns into @a result
+static void recordGame(GameState state, int turns, BalanceResult &result) {
+    ++result.games;
+    result.turns += static_cast<uint64_t>(turns);
+    if (state == GameState::VICTORY) {
+        ++result.victories;
+        result.victoryTurns += static_cast<uint64_t>(turns);
+        ++result.victoryTurnHistogram[turns];
+    } else if (state == GameState::DEFEAT) {
+        ++result.defeats;
+    }
+}
+
+/*!
+ * Plays games [@a firstGame, @a endGame) of one configuration into @a result.
+ */
+static void playGames(const BalanceOptions &options,
+                      const BalanceConfig &config,
+                      int firstGame,
+                      int endGame,
+                      BalanceResult &result) {
+    for (int game = firstGame; game < endGame; ++game) {
+        const uint32_t seed = options.seed + static_cast<uint32_t>(game);
+        GameSession session(seed, config);
+        RandomPlayer player(seed);
+        session.start();
+
+        int turns = 0;
+        GameBoard::Move move;
+        while (session.state() == GameState::PLAYING && turns < options.maxTurns &&
+               player.chooseMove(session.board(), move) &&
+               session.attemptSwap(move.from, move.to)) {
+            ++turns;
+            recordTurn(session.lastCascadeLength(), result);
+        }
+        recordGame(session.state(), turns, result);
+    }
+}
+
+/*!
+ * Plays games [@a firstGame, @a endGame) of one configuration into @a result, @a
+ * SessionBatch::kLanes at a time. Every game makes the same moves it would in @a playGames, so
+ * both produce the same results.
+ */
+static void playGamesBatched(const BalanceOptions &options,
+                             const BalanceConfig &config,
+                             int firstGame,
+                             int endGame,
+                             BalanceResult &result) {
+    constexpr int kLanes = SessionBatch::kLanes;
+    SessionBatch batch(config);
+    std::vector<std::optional<GameSession>> twins(options.check ? kLanes : 0);
+    std::vector<RandomPlayer> players;
+    players.reserve(kLanes);
+    GameBoard board;
+
+    for (int groupStart = firstGame; groupStart < endGame; groupStart += kLanes) {
+        const int laneCount = std::min(kLanes, endGame - groupStart);
+        players.clear();
+        for (int lane = 0; lane < laneCount; ++lane) {
+            const uint32_t seed = options.seed + static_cast<uint32_t>(groupStart + lane);
+            batch.start(lane, seed);
+            players.emplace_back(seed);
+            if (options.check) {
+                twins[lane].emplace(seed, config);
+                twins[lane]->start();
+            }
+        }
+
+        std::array<int, kLanes> turns{};
+        SessionBatch::LaneMask active = (SessionBatch::LaneMask{1} << laneCount) - 1;
+        SessionBatch::Moves moves{};
+        while (active != 0) {
+            SessionBatch::LaneMask moving = 0;
+            for (SessionBatch::LaneMask pending = active; pending; pending &= pending - 1) {
+                const int lane = __builtin_ctz(pending);
+                batch.loadBoard(lane, board);
+                if (players[lane].chooseMove(board, moves[lane])) {
+                    moving |= SessionBatch::LaneMask{1} << lane;
+                }
+            }
+            const SessionBatch::LaneMask swapped = batch.attemptSwaps(moving, moves);
+
+            for (SessionBatch::LaneMask pending = active; pending; pending &= pending - 1) {
+                const int lane = __builtin_ctz(pending);
+                const bool laneSwapped = (swapped >> lane) & 1;
+                if (options.check && (moving >> lane) & 1) {
+                    GameSession &twin = *twins[lane];
+                    const bool twinSwapped = twin.attemptSwap(moves[lane].from, moves[lane].to);
+                    batch.loadBoard(lane, board);
+                    const CombatStats stats = batch.stats(lane);
+                    if (twinSwapped != laneSwapped || board != twin.board() ||
+                        stats.heroHP != twin.heroHP() || stats.enemyHP != twin.enemyHP() ||
+                        stats.heroShield != twin.heroShield() ||
+                        batch.state(lane) != twin.state() ||
+                        batch.lastCascadeLength(lane) != twin.lastCascadeLength()) {
+                        ++result.mismatches;
+                    }
+                }
+                if (laneSwapped) {
+                    ++turns[lane];
+                    recordTurn(batch.lastCascadeLength(lane), result);
+                }
+                if (!laneSwapped || batch.state(lane) != GameState::PLAYING ||
+                    turns[lane] >= options.maxTurns) {
+                    active &= ~(SessionBatch::LaneMask{1} << lane);
+                }
+            }
+        }
+
+        for (int lane = 0; lane < laneCount; ++lane) {
+            recordGame(batch.state(lane), turns[lane], result);
+        }
+    }
+}
+
+static BalanceResult runConfig(const BalanceOptions &options, const BalanceConfig &config) {
+    const int threadCount = std::min(options.threads, options.games);
+    std::vector<BalanceResult> workerResults(static_cast<size_t>(threadCount),
+                                             BalanceResult(options.maxTurns));
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(threadCount));
+    for (int worker = 0; worker < threadCount; ++worker) {
+        const int firstGame = static_cast<int>(
+                static_cast<int64_t>(options.games) * worker / threadCount);
+        const int endGame = static_cast<int>(
+                static_cast<int64_t>(options.games) * (worker + 1) / threadCount);
+        workers.emplace_back(options.batch ? playGamesBatched : playGames,
+                             std::cref(options),
+                             std::cref(config),
+                             firstGame,
+                             endGame,
+                             std::ref(workerResults[static_cast<size_t>(worker)]));
+    }
+
+    BalanceResult total(options.maxTurns);
+    for (int worker = 0; worker < threadCount; ++worker) {
+        workers[static_cast<size_t>(worker)].join();
+        total.merge(workerResults[static_cast<size_t>(worker)]);
+    }
+    return total;
+}
+
+static void printSummaryHeader() {
+    std::printf("%5s %5s %5s %5s | %7s %7s | %8s %5s %5s %5s | %7s %4s\n",
+                "fire", "water", "air", "earth",
+                "win %", "loss %",
+                "turns", "p50", "p90", "max",
+                "cascade", "max");
+}
+
+static void printSummaryRow(const BalanceConfig &config, const BalanceResult &result) {
+    const double games = static_cast<double>(result.games);
+    int maxVictoryTurn = 0;
+    for (size_t turn = 0; turn < result.victoryTurnHistogram.size(); ++turn) {
+        if (result.victoryTurnHistogram[turn] > 0) {
+            maxVictoryTurn = static_cast<int>(turn);
+        }
+    }
+    std::printf("%5d %5d %5d %5d | %7.2f %7.2f | %8.2f %5d %5d %5d | %7.3f %4d\n",
+                config.fireMatchDamage,
+                config.waterMatchHeal,
+                config.airMatchDamage,
+                config.earthMatchShield,
+                100.0 * result.victories / games,
+                100.0 * result.defeats / games,
+                result.victories > 0
+                ? static_cast<double>(result.victoryTurns) / result.victories : 0.0,
+                result.victoryTurnPercentile(0.5),
+                result.victoryTurnPercentile(0.9),
+                maxVictoryTurn,
+                result.turns > 0
+                ? static_cast<double>(result.cascadeSteps) / static_cast<double>(result.turns)
+                : 0.0,
+                result.longestCascade);
+}
+
+static void printCascadeRow(const BalanceConfig &config, const BalanceResult &result) {
+    std::printf("%2d,%2d,%2d,%2d |",
+                config.fireMatchDamage,
+                config.waterMatchHeal,
+                config.airMatchDamage,
+                config.earthMatchShield);
+    const double turns = result.turns > 0 ? static_cast<double>(result.turns) : 1.0;
+    for (int length = 1; length <= kCascadeBuckets; ++length) {
+        std::printf(" %6.2f", 100.0 * static_cast<double>(result.cascadeHistogram[length]) / turns);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char **argv) {
+    BalanceOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    const BalanceConfig::RefillWeights &refill = options.configs.front().refillWeights;
+    std::printf("%d games per configuration, %zu configurations, %d threads, max %d turns,"
+                " refill odds %u:%u:%u:%u, %s%s%s\n\n",
+                options.games, options.configs.size(), options.threads, options.maxTurns,
+                refill[0], refill[1], refill[2], refill[3], heroClassName(options.heroClass),
+                options.specialRunes ? "" : ", no special runes",
+                options.check ? ", batched and checked" : options.batch ? ", batched" : "");
+
+    std::vector<BalanceResult> results;
+    results.reserve(options.configs.size());
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &config: options.configs) {
+        results.push_back(runConfig(options, config));
+    }
+    const double elapsedSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printSummaryHeader();
+    for (size_t i = 0; i < options.configs.size(); ++i) {
+        printSummaryRow(options.configs[i], results[i]);
+    }
+
+    std::printf("\ncascade length distribution, %% of turns\n%-11s |", "config");
+    for (int length = 1; length <= kCascadeBuckets; ++length) {
+        std::printf(" %5d%s", length, length == kCascadeBuckets ? "+" : " ");
+    }
+    std::printf("\n");
+    for (size_t i = 0; i < options.configs.size(); ++i) {
+        printCascadeRow(options.configs[i], results[i]);
+    }
+
+    const double totalGames =
+            static_cast<double>(options.games) * static_cast<double>(options.configs.size());
+    std::printf("\n%.0f games in %.2f s, %.0f games/s\n",
+                totalGames, elapsedSeconds, totalGames / elapsedSeconds);
+
+    if (options.check) {
+        uint64_t mismatches = 0;
+        for (const auto &result: results) {
+            mismatches += result.mismatches;
+        }
+        std::printf("batch check: %llu mismatches against GameSession\n",
+                    static_cast<unsigned long long>(mismatches));
+        return mismatches == 0 ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "CountingAllocator.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+uint64_t gAllocationCount = 0;
+bool gCountAllocations = false;
+
+void *operator new(std::size_t size) {
+    if (gCountAllocations) {
+        ++gAllocationCount;
+    }
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    if (gCountAllocations) {
+        ++gAllocationCount;
+    }
+    // aligned_alloc wants a size that is a whole number of alignments
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = ((size ? size : 1) + align - 1) / align * align;
+    if (void *memory = std::aligned_alloc(align, rounded)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+// every overload frees through this one, so whichever the compiler picks pairs with the malloc
+// or aligned_alloc above
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    operator delete(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+    operator delete(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept {
+    operator delete(memory);
+}
@@ -0,0 +1,15 @@
+#ifndef ANDROIDGLINVESTIGATIONS_COUNTINGALLOCATOR_H
+#define ANDROIDGLINVESTIGATIONS_COUNTINGALLOCATOR_H
+
+#include <cstdint>
+
+/*!
+ * Heap allocations made through the global operator new while @a gCountAllocations is set. Any
+ * executable linking CountingAllocator.cpp has every new and delete, aligned or not, replaced by
+ * ones that go to malloc, aligned_alloc and free and count on the way. They live in a translation
+ * unit of their own so that free is never inlined next to a call of the new it pairs with.
+ */
+extern uint64_t gAllocationCount;
+extern bool gCountAllocations;
+
+#endif //ANDROIDGLINVESTIGATIONS_COUNTINGALLOCATOR_H
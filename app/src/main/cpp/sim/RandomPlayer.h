@@ -0,0 +1,38 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RANDOMPLAYER_H
+#define ANDROIDGLINVESTIGATIONS_RANDOMPLAYER_H
+
+#include <cstdint>
+#include <random>
+
+#include "GameSession.h"
+
+/*!
+ * Picks a uniformly random legal swap every turn. Each player owns its random stream, so games
+ * played on different threads never share state.
+ */
+class RandomPlayer {
+public:
+    /*!
+     * @param seed the seed of the game being played; the player derives its own stream from it so
+     *     it does not replay the session's draws
+     */
+    explicit RandomPlayer(uint32_t seed) : rng_(seed ^ 0x9E3779B9U) {}
+
+    /*!
+     * @return false if the board has no legal swap
+     */
+    bool chooseMove(const GameBoard &board, GameBoard::Move &outMove) {
+        const int moveCount = board.findLegalMoves(moves_);
+        if (moveCount == 0) {
+            return false;
+        }
+        outMove = moves_.moves[std::uniform_int_distribution<int>(0, moveCount - 1)(rng_)];
+        return true;
+    }
+
+private:
+    std::mt19937 rng_;
+    GameBoard::MoveList moves_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_RANDOMPLAYER_H
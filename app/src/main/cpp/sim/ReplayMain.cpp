@@ -0,0 +1,97 @@
+/*!
+ * runebound-replay: plays recorded sessions back as fast as the core allows, checks that each one
+ * ends with the recorded board, stats and game state, and reports the playback rate. Recordings
+ * from devices serve as a regression and performance workload.
+ *
+ *   runebound-replay [--repeat N] FILE...
+ *
+ * Exits with 1 if any replay cannot be read or diverges from its recording.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Replay.h"
+
+static void printUsage() {
+    std::fprintf(stderr, "usage: runebound-replay [--repeat N] FILE...\n");
+}
+
+int main(int argc, char **argv) {
+    int repeat = 1;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            printUsage();
+            return 2;
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+    if (paths.empty() || repeat <= 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<Replay> replays(paths.size());
+    bool failed = false;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!Replay::load(paths[i], replays[i])) {
+            std::fprintf(stderr, "%s: not a replay for this board\n", paths[i].c_str());
+            failed = true;
+        }
+    }
+    if (failed) {
+        return 1;
+    }
+
+    SessionProfile profile;
+    uint64_t swaps = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < repeat; ++pass) {
+        for (size_t i = 0; i < replays.size(); ++i) {
+            const ReplayCheck check = playReplay(replays[i], &profile);
+            swaps += static_cast<uint64_t>(check.swapsApplied + check.swapsRejected);
+            if (pass > 0) {
+                continue;
+            }
+
+            const Replay &replay = replays[i];
+            std::printf("%s: seed %u, %zu swaps (%d rejected), ",
+                        paths[i].c_str(), replay.seed, replay.swaps.size(), check.swapsRejected);
+            if (!replay.hasOutcome) {
+                std::printf("no recorded outcome\n");
+            } else if (check.matches) {
+                std::printf("matches\n");
+            } else {
+                std::printf("DIVERGED (%s%s)\n",
+                            check.boardMatches ? "" : "board ",
+                            check.statsMatch ? "" : "stats");
+                failed = true;
+            }
+        }
+    }
+    const double elapsedSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double sessions = static_cast<double>(replays.size()) * repeat;
+    std::printf("\n%.0f sessions, %llu swaps in %.3f s: %.0f sessions/s, %.0f swaps/s\n",
+                sessions, static_cast<unsigned long long>(swaps), elapsedSeconds,
+                sessions / elapsedSeconds, static_cast<double>(swaps) / elapsedSeconds);
+    for (int stage = 0; stage < kSessionStageCount; ++stage) {
+        if (profile.calls[stage] == 0) {
+            continue;
+        }
+        std::printf("  %-12s %10.1f ns/call\n",
+                    SessionProfile::stageName(static_cast<SessionStage>(stage)),
+                    static_cast<double>(profile.nanoseconds[stage]) /
+                    static_cast<double>(profile.calls[stage]));
+    }
+    return failed ? 1 : 0;
+}
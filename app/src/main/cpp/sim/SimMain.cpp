@@ -0,0 +1,997 @@
+/*!
+ * runebound-sim: plays headless games against runebound_core as fast as possible and reports
+ * throughput and where the time goes.
+ *
+ *   runebound-sim [--games N] [--seed S] [--max-turns T] [--script FILE] [--check-allocs]
+ *                 [--ai [--budget-us B] [--depth D] [--threads T]] [--record DIR]
+ *                 [--snapshot-check] [--predict-check] [--stepwise] [--worker] [--hero CLASS]
+ *                 [--runes-check] [--search-check] [--no-specials] [--particles-check]
+ *
+ * By default every game is seeded with S + game index and the player picks a uniformly random
+ * legal swap each turn. With --script the swaps are read from FILE instead, one
+ * "fromRow fromCol toRow toCol" per line ('#' starts a comment), and a single game is played.
+ * With --ai every swap is chosen by MoveSearch within B microseconds, which doubles as a soak test
+ * of the search; the report adds the depth reached per budget.
+ * --search-check, with --ai, replays every chosen swap through MoveSearch::replaySwap with the
+ * gems the session really drew and fails the run if the search's rules lead to another board or
+ * other stats than the session's.
+ * --record writes every game to DIR/game-SEED.rbr for runebound-replay.
+ * --snapshot-check restores a second session from a snapshot before every turn, plays the same
+ * swap into both and fails the run if they end the turn differently.
+ * --predict-check predicts every swap's outcome before making it and fails the run if the cascade
+ * that follows ends anywhere else; the report adds what a prediction costs.
+ * --stepwise resolves every cascade one phase at a time, as the renderer does, and reports what a
+ * phase costs next to what a whole cascade costs.
+ * --worker plays every game through a SessionWorker thread the way the renderer does, rebuilds the
+ * board from each frame's changes and, separately, the board and stats from its deltas alone and
+ * the stats from its combat events, and fails the run if any of them or the final state differs
+ * from the same game played directly. Move choice is random; --script, --ai and --record do not
+ * apply, the report leaves out the stage table, and the other checks are refused next to it.
+ * --runes-check animates every game's runes as the renderer does, with frames between the phases
+ * of every cascade, through the vector RuneAnimation::step and through stepScalar side by side,
+ * and fails the run if they ever disagree on where a rune is or which runes moved.
+ * --particles-check feeds every game's spawn events to two sets of ParticleEmitters drawing the
+ * same random numbers, steps one pool with ParticlePool::step and the other with stepScalar for
+ * half a second after every turn, and fails the run if their particles or any layer's quads ever
+ * differ.
+ * --check-allocs fails the run if the session touches the heap once it has been created.
+ * --hero plays as warrior (the default), mage, ranger or priestess.
+ * --no-specials plays without special runes.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoardDelta.h"
+#include "CombatEvents.h"
+#include "CountingAllocator.h"
+#include "GameSession.h"
+#include "MoveSearch.h"
+#include "ParticleEmitters.h"
+#include "Replay.h"
+#include "RandomPlayer.h"
+#include "RuneAnimation.h"
+#include "SessionWorker.h"
+
+struct SimOptions {
+    int games = 1000;
+    uint32_t seed = 1;
+    int maxTurns = 500;
+    std::string scriptPath;
+    bool checkAllocations = false;
+    bool useSearch = false;
+    int searchThreads = 0;
+    SearchLimits searchLimits;
+    std::string recordDirectory;
+    bool checkSnapshots = false;
+    bool checkPredictions = false;
+    bool stepwise = false;
+    bool useWorker = false;
+    bool checkRunes = false;
+    bool checkSearch = false;
+    bool checkParticles = false;
+    BalanceConfig balance;
+};
+
+struct SimTotals {
+    int games = 0;
+    int victories = 0;
+    int defeats = 0;
+    uint64_t turns = 0;
+    uint64_t cascadeSteps = 0;
+    int longestCascade = 0;
+    uint64_t moveChoiceNanoseconds = 0;
+    uint64_t allocations = 0;
+    uint64_t searches = 0;
+    uint64_t searchDepth = 0;
+    uint64_t searchNodes = 0;
+    uint64_t searchMicroseconds = 0;
+    int64_t longestSearchMicroseconds = 0;
+    uint64_t snapshots = 0;
+    uint64_t snapshotMismatches = 0;
+    uint64_t snapshotNanoseconds = 0;
+    uint64_t predictions = 0;
+    uint64_t predictionMismatches = 0;
+    uint64_t predictionNanoseconds = 0;
+    uint64_t phases = 0;
+    uint64_t phaseNanoseconds = 0;
+    int64_t longestPhaseNanoseconds = 0;
+    int64_t longestCascadeNanoseconds = 0;
+    uint64_t workerFrames = 0;
+    uint64_t workerDeltas = 0;
+    uint64_t workerCombatEvents = 0;
+    uint64_t workerMismatches = 0;
+    uint64_t runeFrames = 0;
+    uint64_t runeMismatches = 0;
+    uint64_t searchReplays = 0;
+    uint64_t searchMismatches = 0;
+    uint64_t particleFrames = 0;
+    uint64_t particleQuads = 0;
+    uint64_t particleMismatches = 0;
+};
+
+static void printUsage() {
+    std::fprintf(stderr,
+                 "usage: runebound-sim [--games N] [--seed S] [--max-turns T] [--script FILE]"
+                 " [--check-allocs]\n"
+                 "                     [--ai [--budget-us B] [--depth D] [--threads T]]"
+                 " [--record DIR]\n"
+                 "                     [--snapshot-check] [--predict-check] [--stepwise]"
+                 " [--worker] [--hero CLASS]\n"
+                 "                     [--runes-check] [--search-check] [--no-specials]"
+                 " [--particles-check]\n");
+}
+
+static bool parseOptions(int argc, char **argv, SimOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--games") == 0 && hasValue) {
+            options.games = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(arg, "--max-turns") == 0 && hasValue) {
+            options.maxTurns = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--script") == 0 && hasValue) {
+            options.scriptPath = argv[++i];
+        } else if (std::strcmp(arg, "--check-allocs") == 0) {
+            options.checkAllocations = true;
+        } else if (std::strcmp(arg, "--ai") == 0) {
+            options.useSearch = true;
+        } else if (std::strcmp(arg, "--budget-us") == 0 && hasValue) {
+            options.searchLimits.timeBudget = std::chrono::microseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--depth") == 0 && hasValue) {
+            options.searchLimits.maxDepth = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.searchThreads = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--record") == 0 && hasValue) {
+            options.recordDirectory = argv[++i];
+        } else if (std::strcmp(arg, "--snapshot-check") == 0) {
+            options.checkSnapshots = true;
+        } else if (std::strcmp(arg, "--predict-check") == 0) {
+            options.checkPredictions = true;
+        } else if (std::strcmp(arg, "--stepwise") == 0) {
+            options.stepwise = true;
+        } else if (std::strcmp(arg, "--worker") == 0) {
+            options.useWorker = true;
+        } else if (std::strcmp(arg, "--runes-check") == 0) {
+            options.checkRunes = true;
+        } else if (std::strcmp(arg, "--search-check") == 0) {
+            options.checkSearch = true;
+        } else if (std::strcmp(arg, "--particles-check") == 0) {
+            options.checkParticles = true;
+        } else if (std::strcmp(arg, "--no-specials") == 0) {
+            options.balance.specialRunes = false;
+        } else if (std::strcmp(arg, "--hero") == 0 && hasValue) {
+            if (!parseHeroClass(argv[++i], options.balance.heroClass)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    // the worker plays its own loop, which none of the other checks hook into
+    const bool workerChecks = options.checkAllocations || options.checkSnapshots ||
+                              options.checkPredictions || options.checkRunes ||
+                              options.checkSearch || options.checkParticles;
+    return options.games > 0 && options.maxTurns > 0 &&
+           (!options.checkSearch || options.useSearch) &&
+           (!options.useWorker || !workerChecks);
+}
+
+static bool loadScript(const std::string &path, std::vector<GameBoard::Move> &outMoves) {
+    std::ifstream file(path);
+    if (!file) {
+        std::fprintf(stderr, "cannot open script %s\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        const auto comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream fields(line);
+        int fromRow, fromCol, toRow, toCol;
+        if (!(fields >> fromRow)) {
+            continue;
+        }
+        if (!(fields >> fromCol >> toRow >> toCol) ||
+            fromRow < 0 || fromRow >= GameBoard::kRows || toRow < 0 || toRow >= GameBoard::kRows ||
+            fromCol < 0 || fromCol >= GameBoard::kColumns ||
+            toCol < 0 || toCol >= GameBoard::kColumns) {
+            std::fprintf(stderr, "%s:%d: expected four in-range cell coordinates\n",
+                         path.c_str(), lineNumber);
+            return false;
+        }
+        GameBoard::Move move;
+        move.from = static_cast<uint8_t>(GameBoard::cellIndex(fromRow, fromCol));
+        move.to = static_cast<uint8_t>(GameBoard::cellIndex(toRow, toCol));
+        outMoves.push_back(move);
+    }
+    return true;
+}
+
+/*!
+ * Applies the changes @a frame reports to @a board, as the renderer applies them to its runes.
+ */
+static void applyFrameChanges(const SessionFrame &frame, GameBoard &board) {
+    if (frame.reset) {
+        board = frame.board;
+        return;
+    }
+    if (frame.hasSwap()) {
+        board.swapCells(frame.swapFirst, frame.swapSecond);
+    }
+    frame.cleared.forEach([&board](int index) {
+        board.set(index, GemType::None);
+    });
+    frame.formedSpecials.forEach([&board, &frame](int index) {
+        board.setSpecial(index, frame.board.special(index));
+    });
+    // bottom up, so every gem is picked up before another one lands on it; the cells a fall
+    // leaves behind are all either landed on or refilled
+    const GameBoard::Gravity &gravity = frame.gravity;
+    for (int index = GameBoard::kCells - 1; index >= 0; --index) {
+        if (gravity.moved.test(index)) {
+            board.moveGem(index - gravity.fallRows[index] * GameBoard::kColumns, index);
+        }
+    }
+    gravity.refilled.forEach([&board, &frame](int index) {
+        board.set(index, frame.board.at(index));
+    });
+}
+
+/*!
+ * The stats and state as the newest combat events left them.
+ */
+struct CombatEventMirror {
+    CombatStats stats;
+    GameState state = GameState::START;
+
+    void apply(const CombatEvent &event) {
+        switch (event.kind) {
+            case CombatEventKind::Damage:
+                stats.enemyHP = event.value;
+                break;
+            case CombatEventKind::Heal:
+                stats.heroHP = event.value;
+                break;
+            case CombatEventKind::Shield:
+                stats.heroShield = event.value;
+                break;
+            case CombatEventKind::State:
+                state = static_cast<GameState>(event.value);
+                break;
+            case CombatEventKind::Spawn:
+                break;
+        }
+    }
+};
+
+/*!
+ * Plays one game through a @a SessionWorker and the same game on a session of its own, and
+ * counts every frame whose changes, deltas or combat events do not rebuild its board and stats,
+ * and every game that ends apart.
+ */
+static void playWorkerGame(const SimOptions &options, uint32_t seed, SimTotals &totals) {
+    SessionWorker worker(seed, options.balance);
+    worker.session().start();
+    worker.start();
+    GameSession direct(seed, options.balance);
+    direct.start();
+    RandomPlayer player(seed);
+
+    GameBoard rebuilt;
+    BoardDeltaMirror mirror;
+    CombatEventMirror combatMirror;
+    CombatEventRing::Cursor combatCursor;
+    const SessionFrame *frame = nullptr;
+    int turns = 0;
+    for (;;) {
+        const SessionFrame *next = worker.acquireFrame();
+        if (!next) {
+            std::this_thread::yield();
+            continue;
+        }
+        frame = next;
+        ++totals.workerFrames;
+        applyFrameChanges(*frame, rebuilt);
+        if (!(rebuilt == frame->board)) {
+            ++totals.workerMismatches;
+            rebuilt = frame->board;
+        }
+        bool mirrored = true;
+        for (int i = 0; i < frame->deltaCount; ++i) {
+            mirrored &= mirror.apply(frame->deltas[i]);
+        }
+        totals.workerDeltas += static_cast<uint64_t>(frame->deltaCount);
+        if (!mirrored || !(mirror.board == frame->board) || mirror.state != frame->state ||
+            mirror.stats.heroHP != frame->stats.heroHP ||
+            mirror.stats.enemyHP != frame->stats.enemyHP ||
+            mirror.stats.heroShield != frame->stats.heroShield) {
+            ++totals.workerMismatches;
+        }
+        // the worker may already be pushing the next step's events meanwhile
+        totals.workerCombatEvents += static_cast<uint64_t>(worker.combatEvents().poll(
+                combatCursor, frame->combatEventEnd, [&combatMirror](const CombatEvent &event) {
+                    combatMirror.apply(event);
+                }));
+        if (combatCursor.next != frame->combatEventEnd || combatCursor.dropped != 0 ||
+            combatMirror.state != frame->state ||
+            combatMirror.stats.heroHP != frame->stats.heroHP ||
+            combatMirror.stats.enemyHP != frame->stats.enemyHP ||
+            combatMirror.stats.heroShield != frame->stats.heroShield) {
+            ++totals.workerMismatches;
+        }
+        if (frame->phase != CascadePhase::Idle) {
+            continue;
+        }
+        if (frame->state != GameState::PLAYING) {
+            break;
+        }
+
+        GameBoard::Move move;
+        if (turns >= options.maxTurns || !player.chooseMove(frame->board, move)) {
+            break;
+        }
+        direct.attemptSwap(move.from, move.to);
+        totals.cascadeSteps += static_cast<uint64_t>(direct.lastCascadeLength());
+        totals.longestCascade = std::max(totals.longestCascade, direct.lastCascadeLength());
+        while (!worker.submitSwap(move.from, move.to)) {
+            std::this_thread::yield();
+        }
+        ++turns;
+    }
+    worker.stop();
+
+    const CombatStats &stats = frame->stats;
+    if (!(frame->board == direct.board()) || frame->state != direct.state() ||
+        stats.heroHP != direct.heroHP() || stats.enemyHP != direct.enemyHP() ||
+        stats.heroShield != direct.heroShield()) {
+        ++totals.workerMismatches;
+    }
+
+    ++totals.games;
+    totals.turns += static_cast<uint64_t>(turns);
+    if (frame->state == GameState::VICTORY) {
+        ++totals.victories;
+    } else if (frame->state == GameState::DEFEAT) {
+        ++totals.defeats;
+    }
+}
+
+//! frames the rune check shows between two phases of a cascade, as the renderer's budget allows
+static constexpr int kRuneFramesPerPhase = 3;
+//! at most this many frames after a cascade for every rune to reach its cell
+static constexpr int kRuneFramesToSettle = 120;
+//! frames the particle check plays after every turn, so effects of several turns overlap
+static constexpr int kParticleFramesPerTurn = 30;
+
+/*!
+ * Moves two sets of runes the way the renderer moves its own, one stepped by the vector
+ * RuneAnimation::step and one by stepScalar, and counts every frame on which they part.
+ */
+class RuneMotionCheck : public GameSessionListener {
+public:
+    explicit RuneMotionCheck(const GameSession &session) : session_(session) {}
+
+    void onBoardReset() override {
+        for (RuneAnimation &runes: motions_) {
+            runes.clear();
+        }
+        for (int index = 0; index < GameBoard::kCells; ++index) {
+            setTarget(index);
+        }
+    }
+
+    void onGemsSwapped(int firstIndex, int secondIndex) override {
+        for (RuneAnimation &runes: motions_) {
+            runes.swap(firstIndex, secondIndex);
+        }
+        setTarget(firstIndex);
+        setTarget(secondIndex);
+    }
+
+    void onGemsCleared(const GameBoard::Mask &cells) override {
+        cells.forEach([this](int index) {
+            for (RuneAnimation &runes: motions_) {
+                runes.reset(index);
+            }
+        });
+    }
+
+    void onGemsFell(const GameBoard::Gravity &gravity) override {
+        for (RuneAnimation &runes: motions_) {
+            runes.fall(gravity, -kCellSize);
+        }
+        gravity.refilled.forEach([this, &gravity](int index) {
+            // new runes start stacked above the board, as the renderer drops them
+            for (RuneAnimation &runes: motions_) {
+                runes.reset(index);
+                runes.place(index, centerX(index),
+                            centerY(index) + gravity.fallRows[index] * kCellSize);
+            }
+            setTarget(index);
+        });
+    }
+
+    /*!
+     * Steps both sets by up to @a frames frames at 60 per second, stopping early once no rune
+     * moves.
+     */
+    void animate(int frames, SimTotals &totals) {
+        constexpr float kBlend = 10.0f / 60.0f;
+        constexpr float kSnapDistance = 1.0f;
+        for (int frame = 0; frame < frames; ++frame) {
+            const GameBoard::Mask vectorMoving = motions_[0].step(kBlend, kSnapDistance);
+            const GameBoard::Mask scalarMoving = motions_[1].stepScalar(kBlend, kSnapDistance);
+            ++totals.runeFrames;
+            bool same = vectorMoving == scalarMoving;
+            for (int index = 0; index < GameBoard::kCells; ++index) {
+                same &= motions_[0].x(index) == motions_[1].x(index) &&
+                        motions_[0].y(index) == motions_[1].y(index);
+            }
+            if (!same) {
+                ++totals.runeMismatches;
+                motions_[1] = motions_[0];
+            }
+            if (vectorMoving.none()) {
+                return;
+            }
+        }
+    }
+
+private:
+    static constexpr float kCellSize = 100.0f;
+
+    static float centerX(int index) {
+        return (static_cast<float>(GameBoard::columnOf(index)) + 0.5f) * kCellSize;
+    }
+
+    //! rows go down the screen
+    static float centerY(int index) {
+        return -(static_cast<float>(GameBoard::rowOf(index)) + 0.5f) * kCellSize;
+    }
+
+    void setTarget(int index) {
+        if (session_.board().at(index) == GemType::None) {
+            return;
+        }
+        for (RuneAnimation &runes: motions_) {
+            runes.setTarget(index, centerX(index), centerY(index));
+        }
+    }
+
+    const GameSession &session_;
+    //! stepped by the vector path, then by the scalar one
+    std::array<RuneAnimation, 2> motions_;
+};
+
+/*!
+ * Two particle pools fed by two sets of emitters from the same random stream, one stepped by the
+ * vector ParticlePool::step and one by stepScalar, as the renderer feeds its own from a session's
+ * spawn events.
+ */
+class ParticleCheck {
+public:
+    explicit ParticleCheck(uint32_t seed) :
+            vectorSide_(seed),
+            scalarSide_(seed),
+            vectorQuads_(ParticlePool::kCapacity * ParticlePool::kVerticesPerParticle),
+            scalarQuads_(ParticlePool::kCapacity * ParticlePool::kVerticesPerParticle) {}
+
+    /*!
+     * Starts the effects of every spawn event in @a events since the last call, then plays
+     * @a frames frames at 60 per second and counts every frame on which the two pools part.
+     */
+    void update(const CombatEventRing &events, int frames, SimTotals &totals) {
+        events.poll(cursor_, [this](const CombatEvent &event) {
+            if (event.kind == CombatEventKind::Spawn) {
+                trigger(event);
+            }
+        });
+
+        constexpr float kFrameSeconds = 1.0f / 60.0f;
+        for (int frame = 0; frame < frames; ++frame) {
+            const int vectorExpired = vectorSide_.pool.step(kFrameSeconds);
+            const int scalarExpired = scalarSide_.pool.stepScalar(kFrameSeconds);
+            vectorSide_.emitters.update(kFrameSeconds, vectorSide_.pool, vectorSide_.rng);
+            scalarSide_.emitters.update(kFrameSeconds, scalarSide_.pool, scalarSide_.rng);
+            ++totals.particleFrames;
+
+            bool same = vectorExpired == scalarExpired &&
+                        vectorSide_.pool.size() == scalarSide_.pool.size();
+            for (int layer = 0; same && layer < kElementSpawnCount; ++layer) {
+                const auto layerId = static_cast<uint8_t>(layer);
+                const int quads = vectorSide_.pool.emitQuads(vectorQuads_.data(), 0.0f, layerId);
+                same = quads == scalarSide_.pool.emitQuads(scalarQuads_.data(), 0.0f, layerId) &&
+                       std::memcmp(vectorQuads_.data(), scalarQuads_.data(),
+                                   sizeof(ParticleVertex) * ParticlePool::kVerticesPerParticle *
+                                   static_cast<size_t>(quads)) == 0;
+                totals.particleQuads += static_cast<uint64_t>(quads);
+            }
+            if (!same) {
+                ++totals.particleMismatches;
+                scalarSide_ = vectorSide_;
+            }
+        }
+    }
+
+private:
+    //! cells are this many units across, as the renderer's are pixels
+    static constexpr float kCellSize = 100.0f;
+
+    struct Side {
+        explicit Side(uint32_t seed) : rng(seed) {}
+
+        ParticlePool pool;
+        ParticleEmitters emitters;
+        Pcg32 rng;
+    };
+
+    //! starts the effect at the middle of the event's cells, as the renderer does
+    void trigger(const CombatEvent &event) {
+        float sumX = 0.0f;
+        float sumY = 0.0f;
+        event.cells.forEach([&sumX, &sumY](int index) {
+            sumX += static_cast<float>(GameBoard::columnOf(index)) * kCellSize;
+            sumY -= static_cast<float>(GameBoard::rowOf(index)) * kCellSize;
+        });
+        const int gems = event.cells.count();
+        if (gems == 0) {
+            return;
+        }
+        const float x = sumX / static_cast<float>(gems);
+        const float y = sumY / static_cast<float>(gems);
+        vectorSide_.emitters.trigger(event.spawn, x, y, gems, kCellSize);
+        scalarSide_.emitters.trigger(event.spawn, x, y, gems, kCellSize);
+    }
+
+    Side vectorSide_;
+    Side scalarSide_;
+    std::vector<ParticleVertex> vectorQuads_;
+    std::vector<ParticleVertex> scalarQuads_;
+    CombatEventRing::Cursor cursor_;
+};
+
+/*!
+ * Notes the gems a session draws as it refills, column by column in the order it draws them, and
+ * whether it had to deal or reshuffle the board.
+ */
+class RefillRecorder : public GameSessionListener {
+public:
+    explicit RefillRecorder(const GameSession &session) : session_(session) {}
+
+    void clear() {
+        refills.clear();
+        boardReset = false;
+    }
+
+    void onBoardReset() override {
+        boardReset = true;
+    }
+
+    void onGemsFell(const GameBoard::Gravity &gravity) override {
+        // each column draws its bottom-most empty cell first
+        for (int column = 0; column < GameBoard::kColumns; ++column) {
+            for (int row = GameBoard::kRows - 1; row >= 0; --row) {
+                const int index = GameBoard::cellIndex(row, column);
+                if (gravity.refilled.test(index)) {
+                    refills.push(column, session_.board().at(index));
+                }
+            }
+        }
+    }
+
+    RefillScript refills;
+    bool boardReset = false;
+
+private:
+    const GameSession &session_;
+};
+
+/*!
+ * Plays @a move on a copy of @a session and through @a search with the refills the copy drew, and
+ * counts a mismatch if the search ends on other stats or, with the battle still on and no new
+ * board dealt, on another board.
+ */
+static void checkSearchReplay(const GameSession &session,
+                              const GameBoard::Move &move,
+                              MoveSearch &search,
+                              SimTotals &totals) {
+    GameSession played(session);
+    RefillRecorder recorder(played);
+    played.setListener(&recorder);
+    played.setProfile(nullptr);
+    played.setStepwiseCascades(false);
+    if (!played.attemptSwap(move.from, move.to) || recorder.refills.overflowed) {
+        return;
+    }
+
+    GameBoard board;
+    CombatStats stats;
+    search.replaySwap(session, move, recorder.refills, board, stats);
+    ++totals.searchReplays;
+    const CombatStats &expected = played.stats();
+    if (stats.heroHP != expected.heroHP || stats.enemyHP != expected.enemyHP ||
+        stats.heroShield != expected.heroShield ||
+        (played.state() == GameState::PLAYING && !recorder.boardReset &&
+         !(board == played.board()))) {
+        ++totals.searchMismatches;
+    }
+}
+
+/*!
+ * Plays one game to its end or to @a SimOptions::maxTurns.
+ * @param script swaps to play in order, or null to let @a search or a random player choose
+ * @param search picks every swap if not null
+ */
+static void playGame(const SimOptions &options,
+                     uint32_t seed,
+                     const std::vector<GameBoard::Move> *script,
+                     MoveSearch *search,
+                     SessionProfile &profile,
+                     SimTotals &totals) {
+    GameSession session(seed, options.balance);
+    session.setProfile(&profile);
+    // the rune check animates between phases, so it needs them one at a time
+    session.setStepwiseCascades(options.stepwise || options.checkRunes);
+    RuneMotionCheck runeCheck(session);
+    if (options.checkRunes) {
+        session.setListener(&runeCheck);
+    }
+    // two full pools take half a megabyte, too much for the stack
+    std::unique_ptr<ParticleCheck> particleCheck;
+    CombatEventRing combatEvents;
+    if (options.checkParticles) {
+        particleCheck.reset(new ParticleCheck(seed));
+        session.setCombatEvents(&combatEvents);
+    }
+    RandomPlayer player(seed);
+    const bool recording = !options.recordDirectory.empty();
+    ReplayRecorder recorder;
+    if (recording) {
+        recorder.begin(seed, session.balance());
+    }
+
+    GameSession resumed(seed, options.balance);
+    SessionSnapshot snapshot;
+
+    const uint64_t allocationsBefore = gAllocationCount;
+    gCountAllocations = options.checkAllocations;
+
+    session.start();
+    int turns = 0;
+    size_t scriptPosition = 0;
+    while (session.state() == GameState::PLAYING && turns < options.maxTurns) {
+        GameBoard::Move move;
+        if (script) {
+            if (scriptPosition == script->size()) {
+                break;
+            }
+            move = (*script)[scriptPosition++];
+        } else {
+            const auto choiceStart = std::chrono::steady_clock::now();
+            if (search) {
+                const SearchResult result = search->search(session, options.searchLimits);
+                if (!result.found) {
+                    break;
+                }
+                move = result.move;
+                ++totals.searches;
+                totals.searchDepth += static_cast<uint64_t>(result.completedDepth);
+                totals.searchNodes += result.nodes;
+                totals.searchMicroseconds += static_cast<uint64_t>(result.elapsed.count());
+                if (result.elapsed.count() > totals.longestSearchMicroseconds) {
+                    totals.longestSearchMicroseconds = result.elapsed.count();
+                }
+            } else if (!player.chooseMove(session.board(), move)) {
+                break;
+            }
+            totals.moveChoiceNanoseconds += static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - choiceStart).count());
+            if (search && options.checkSearch) {
+                checkSearchReplay(session, move, *search, totals);
+            }
+        }
+
+        if (recording) {
+            recorder.recordSwap(move.from, move.to);
+        }
+        bool resumedSwapped = false;
+        if (options.checkSnapshots) {
+            const auto snapshotStart = std::chrono::steady_clock::now();
+            const bool restored = session.saveSnapshot(snapshot) &&
+                                  resumed.restoreSnapshot(snapshot);
+            totals.snapshotNanoseconds += static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - snapshotStart).count());
+            ++totals.snapshots;
+            if (!restored) {
+                ++totals.snapshotMismatches;
+            }
+            resumedSwapped = resumed.attemptSwap(move.from, move.to);
+        }
+        SwapOutcome predicted;
+        bool predictedSwap = false;
+        if (options.checkPredictions) {
+            const auto predictionStart = std::chrono::steady_clock::now();
+            predictedSwap = session.predictSwap(move.from, move.to, predicted);
+            totals.predictionNanoseconds += static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - predictionStart).count());
+            ++totals.predictions;
+        }
+        const CombatStats statsBefore = session.stats();
+        const bool swapped = session.attemptSwap(move.from, move.to);
+        int64_t cascadeNanoseconds = 0;
+        while (session.isResolving()) {
+            if (options.checkRunes) {
+                runeCheck.animate(kRuneFramesPerPhase, totals);
+            }
+            const auto phaseStart = std::chrono::steady_clock::now();
+            session.stepCascade();
+            const int64_t phaseNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - phaseStart).count();
+            cascadeNanoseconds += phaseNanoseconds;
+            ++totals.phases;
+            totals.phaseNanoseconds += static_cast<uint64_t>(phaseNanoseconds);
+            totals.longestPhaseNanoseconds =
+                    std::max(totals.longestPhaseNanoseconds, phaseNanoseconds);
+        }
+        totals.longestCascadeNanoseconds =
+                std::max(totals.longestCascadeNanoseconds, cascadeNanoseconds);
+        if (options.checkRunes) {
+            runeCheck.animate(kRuneFramesToSettle, totals);
+        }
+        if (particleCheck) {
+            particleCheck->update(combatEvents, kParticleFramesPerTurn, totals);
+        }
+        if (options.checkSnapshots &&
+            (resumedSwapped != swapped || !(resumed.board() == session.board()) ||
+             resumed.state() != session.state() || resumed.heroHP() != session.heroHP() ||
+             resumed.enemyHP() != session.enemyHP() ||
+             resumed.heroShield() != session.heroShield())) {
+            ++totals.snapshotMismatches;
+        }
+        if (options.checkPredictions &&
+            (predictedSwap != swapped ||
+             (swapped && (predicted.cascadeLength != session.lastCascadeLength() ||
+                          predicted.state != session.state() ||
+                          predicted.enemyDamage != statsBefore.enemyHP - session.enemyHP() ||
+                          predicted.heroHeal != session.heroHP() - statsBefore.heroHP ||
+                          predicted.shieldGain != session.heroShield() - statsBefore.heroShield)))) {
+            ++totals.predictionMismatches;
+        }
+        if (!swapped) {
+            if (script) {
+                std::fprintf(stderr, "script swap %zu (%d,%d)->(%d,%d) is not legal, skipped\n",
+                             scriptPosition,
+                             GameBoard::rowOf(move.from), GameBoard::columnOf(move.from),
+                             GameBoard::rowOf(move.to), GameBoard::columnOf(move.to));
+                continue;
+            }
+            break;
+        }
+        ++turns;
+        totals.cascadeSteps += static_cast<uint64_t>(session.lastCascadeLength());
+        if (session.lastCascadeLength() > totals.longestCascade) {
+            totals.longestCascade = session.lastCascadeLength();
+        }
+    }
+
+    gCountAllocations = false;
+    totals.allocations += gAllocationCount - allocationsBefore;
+
+    if (recording) {
+        recorder.finish(session);
+        const std::string path =
+                options.recordDirectory + "/game-" + std::to_string(seed) + ".rbr";
+        if (!recorder.replay().save(path)) {
+            std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        }
+    }
+
+    ++totals.games;
+    totals.turns += static_cast<uint64_t>(turns);
+    if (session.state() == GameState::VICTORY) {
+        ++totals.victories;
+    } else if (session.state() == GameState::DEFEAT) {
+        ++totals.defeats;
+    }
+
+    if (script) {
+        std::printf("final state: hero %d/%d shield %d, enemy %d/%d after %d turns\n",
+                    session.heroHP(), GameSession::kHeroMaxHP, session.heroShield(),
+                    session.enemyHP(), GameSession::kEnemyMaxHP, turns);
+    }
+}
+
+static void printReport(const SimOptions &options,
+                        const SimTotals &totals,
+                        const SessionProfile &profile,
+                        double elapsedSeconds) {
+    const double games = static_cast<double>(totals.games);
+    const double turns = static_cast<double>(totals.turns);
+    std::printf("games        %d (%d victories, %d defeats, %d unfinished)\n",
+                totals.games, totals.victories, totals.defeats,
+                totals.games - totals.victories - totals.defeats);
+    std::printf("turns        %.2f per game, cascade %.2f steps per turn (longest %d)\n",
+                turns / games,
+                turns > 0 ? static_cast<double>(totals.cascadeSteps) / turns : 0.0,
+                totals.longestCascade);
+    std::printf("throughput   %.0f games/s, %.0f turns/s (%.3f s total)\n",
+                games / elapsedSeconds, turns / elapsedSeconds, elapsedSeconds);
+    if (totals.searches > 0) {
+        const double searches = static_cast<double>(totals.searches);
+        const double budgetMilliseconds =
+                static_cast<double>(options.searchLimits.timeBudget.count()) / 1000.0;
+        const double searchMilliseconds = static_cast<double>(totals.searchMicroseconds) / 1000.0;
+        std::printf("search       depth %.2f in %.3f ms budget (%.2f per ms), %.0f nodes/ms,"
+                    " mean %.0f us, longest %lld us\n",
+                    static_cast<double>(totals.searchDepth) / searches,
+                    budgetMilliseconds,
+                    static_cast<double>(totals.searchDepth) / searches / budgetMilliseconds,
+                    searchMilliseconds > 0.0
+                    ? static_cast<double>(totals.searchNodes) / searchMilliseconds : 0.0,
+                    static_cast<double>(totals.searchMicroseconds) / searches,
+                    static_cast<long long>(totals.longestSearchMicroseconds));
+    }
+
+    if (options.useWorker) {
+        std::printf("worker       %llu frames, %.1f per turn, %.1f delta bytes per turn, "
+                    "%.1f combat events per turn, %llu mismatches\n",
+                    static_cast<unsigned long long>(totals.workerFrames),
+                    turns > 0 ? static_cast<double>(totals.workerFrames) / turns : 0.0,
+                    turns > 0 ? static_cast<double>(totals.workerDeltas * sizeof(BoardDelta)) /
+                                turns : 0.0,
+                    turns > 0 ? static_cast<double>(totals.workerCombatEvents) / turns : 0.0,
+                    static_cast<unsigned long long>(totals.workerMismatches));
+    }
+
+    if (options.stepwise) {
+        std::printf("stepwise     phase mean %.0f ns, cascade mean %.0f ns;"
+                    " longest phase %.1f us, longest cascade %.1f us\n",
+                    totals.phases > 0 ? static_cast<double>(totals.phaseNanoseconds) /
+                                        static_cast<double>(totals.phases) : 0.0,
+                    turns > 0 ? static_cast<double>(totals.phaseNanoseconds) / turns : 0.0,
+                    static_cast<double>(totals.longestPhaseNanoseconds) / 1000.0,
+                    static_cast<double>(totals.longestCascadeNanoseconds) / 1000.0);
+    }
+
+    if (options.checkSearch) {
+        std::printf("replays      %llu swaps replayed through the search, %llu mismatches\n",
+                    static_cast<unsigned long long>(totals.searchReplays),
+                    static_cast<unsigned long long>(totals.searchMismatches));
+    }
+
+    if (options.checkParticles) {
+        std::printf("particles    %llu frames stepped both ways, %.1f quads per frame,"
+                    " %llu mismatches\n",
+                    static_cast<unsigned long long>(totals.particleFrames),
+                    totals.particleFrames > 0
+                    ? static_cast<double>(totals.particleQuads) /
+                      static_cast<double>(totals.particleFrames) : 0.0,
+                    static_cast<unsigned long long>(totals.particleMismatches));
+    }
+
+    if (options.checkRunes) {
+        std::printf("runes        %llu frames stepped both ways, %llu mismatches\n",
+                    static_cast<unsigned long long>(totals.runeFrames),
+                    static_cast<unsigned long long>(totals.runeMismatches));
+    }
+
+    if (totals.snapshots > 0) {
+        std::printf("snapshots    %llu round trips of %zu bytes, %.1f ns each, %llu mismatches\n",
+                    static_cast<unsigned long long>(totals.snapshots),
+                    SessionSnapshot::kBytes,
+                    static_cast<double>(totals.snapshotNanoseconds) /
+                    static_cast<double>(totals.snapshots),
+                    static_cast<unsigned long long>(totals.snapshotMismatches));
+    }
+
+    if (totals.predictions > 0) {
+        std::printf("predictions  %llu swaps, %.1f ns each, %llu mismatches\n",
+                    static_cast<unsigned long long>(totals.predictions),
+                    static_cast<double>(totals.predictionNanoseconds) /
+                    static_cast<double>(totals.predictions),
+                    static_cast<unsigned long long>(totals.predictionMismatches));
+    }
+
+    // the worker's session is not profiled, so its stages have nothing to show
+    if (options.useWorker) {
+        return;
+    }
+
+    uint64_t profiledNanoseconds = totals.moveChoiceNanoseconds;
+    for (const auto nanoseconds: profile.nanoseconds) {
+        profiledNanoseconds += nanoseconds;
+    }
+    const double total = profiledNanoseconds > 0 ? static_cast<double>(profiledNanoseconds) : 1.0;
+
+    std::printf("\n%-12s %12s %12s %10s %7s\n", "stage", "calls", "total ms", "ns/call", "share");
+    const auto printStage = [total](const char *name, uint64_t calls, uint64_t nanoseconds) {
+        std::printf("%-12s %12llu %12.3f %10.1f %6.1f%%\n",
+                    name,
+                    static_cast<unsigned long long>(calls),
+                    static_cast<double>(nanoseconds) / 1e6,
+                    calls > 0 ? static_cast<double>(nanoseconds) / static_cast<double>(calls) : 0.0,
+                    100.0 * static_cast<double>(nanoseconds) / total);
+    };
+    printStage("move choice", totals.turns, totals.moveChoiceNanoseconds);
+    for (int stage = 0; stage < kSessionStageCount; ++stage) {
+        printStage(SessionProfile::stageName(static_cast<SessionStage>(stage)),
+                   profile.calls[stage],
+                   profile.nanoseconds[stage]);
+    }
+}
+
+int main(int argc, char **argv) {
+    SimOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<GameBoard::Move> script;
+    if (!options.scriptPath.empty()) {
+        if (!loadScript(options.scriptPath, script)) {
+            return 1;
+        }
+        options.games = 1;
+    }
+
+    std::unique_ptr<MoveSearch> search;
+    if (options.useSearch) {
+        search.reset(new MoveSearch(options.searchThreads));
+    }
+
+    SessionProfile profile;
+    SimTotals totals;
+    const auto start = std::chrono::steady_clock::now();
+    for (int game = 0; game < options.games; ++game) {
+        if (options.useWorker) {
+            playWorkerGame(options, options.seed + static_cast<uint32_t>(game), totals);
+            continue;
+        }
+        playGame(options,
+                 options.seed + static_cast<uint32_t>(game),
+                 options.scriptPath.empty() ? nullptr : &script,
+                 search.get(),
+                 profile,
+                 totals);
+    }
+    const double elapsedSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printReport(options, totals, profile, elapsedSeconds);
+
+    if (totals.snapshotMismatches != 0 || totals.workerMismatches != 0 ||
+        totals.predictionMismatches != 0 || totals.runeMismatches != 0 ||
+        totals.searchMismatches != 0 || totals.particleMismatches != 0) {
+        return 1;
+    }
+    if (options.checkAllocations) {
+        std::printf("\nheap allocations during play: %llu\n",
+                    static_cast<unsigned long long>(totals.allocations));
+        if (totals.allocations != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
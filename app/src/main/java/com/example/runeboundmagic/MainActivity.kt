@@ -30,6 +30,8 @@ class MainActivity : GameActivity() {
     }
 
     override fun onCreate(savedInstanceState: android.os.Bundle?) {
+        // the game thread starts in super.onCreate and reads the hero when its window comes up
+        nativeSetHeroClass(nativeHeroClass(intent.getStringExtra(EXTRA_SELECTED_HERO)))
         super.onCreate(savedInstanceState)
         setupSelectionOverlay()
     }
@@ -82,6 +84,20 @@ class MainActivity : GameActivity() {
         )
     }
 
+    /**
+     * Ordinal of the native HeroClass (ElementEffects.h) for the [HeroOption] named [heroName],
+     * resolved through [HeroOption.fromName] like the rest of the app, so a missing or unknown
+     * name plays as the hero it shows.
+     */
+    private fun nativeHeroClass(heroName: String?): Int = when (HeroOption.fromName(heroName)) {
+        HeroOption.WARRIOR -> 0
+        HeroOption.MAGE -> 1
+        HeroOption.RANGER -> 2
+        HeroOption.MYSTICAL_PRIESTESS -> 3
+    }
+
+    private external fun nativeSetHeroClass(heroClass: Int)
+
     private fun hideSystemUi() {
         val decorView = window.decorView
         decorView.systemUiVisibility = (View.SYSTEM_UI_FLAG_IMMERSIVE_STICKY